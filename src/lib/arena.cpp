@@ -0,0 +1,205 @@
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include <malloc.h>
+
+#include "arena.h"
+
+// what the allocator actually reserved for `p`
+static inline size_t block_size(void* p)
+{
+#ifdef _WIN32
+    return _msize(p);
+#else
+    return malloc_usable_size(p);
+#endif
+}
+
+static std::atomic<size_t> _heap_allocations{0};
+static std::atomic<size_t> _heap_bytes{0};
+static std::atomic<size_t> _heap_live_bytes{0};
+// per thread as well, for attributing them to scopes
+thread_local size_t _thread_allocations = 0;
+thread_local size_t _thread_bytes = 0;
+
+// counting replacements of the global allocation functions, the array and
+// nothrow forms forward here by default
+void* operator new(size_t n)
+{
+    _heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    _heap_bytes.fetch_add(n, std::memory_order_relaxed);
+    ++_thread_allocations;
+    _thread_bytes += n;
+    if (void* p = std::malloc(n ? n : 1)) {
+        _heap_live_bytes.fetch_add(block_size(p), std::memory_order_relaxed);
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p) {
+        _heap_live_bytes.fetch_sub(block_size(p), std::memory_order_relaxed);
+    }
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+size_t heap_allocations()
+{
+    return _heap_allocations.load(std::memory_order_relaxed);
+}
+
+size_t heap_bytes()
+{
+    return _heap_bytes.load(std::memory_order_relaxed);
+}
+
+size_t heap_live_bytes()
+{
+    return _heap_live_bytes.load(std::memory_order_relaxed);
+}
+
+// a fixed table, scopes are few and the counters are updated from any thread
+const int ALLOC_SLOTS = 64;
+
+struct alloc_slot_t {
+    std::string name;
+    std::atomic<size_t> calls{0};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> max_allocations{0};
+};
+
+static std::atomic<bool> _alloc_tracking{false};
+static std::mutex _alloc_mutex;
+static alloc_slot_t _alloc_slots[ALLOC_SLOTS];
+static int _alloc_slots_used = 0;
+
+void alloc_tracking(bool on)
+{
+    _alloc_tracking = on;
+}
+
+bool alloc_tracking()
+{
+    return _alloc_tracking;
+}
+
+static int alloc_slot(std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(_alloc_mutex);
+    for(int i = 0; i < _alloc_slots_used; ++i) {
+        if (_alloc_slots[i].name == name) {
+            return i;
+        }
+    }
+    if (_alloc_slots_used == ALLOC_SLOTS) {
+        return -1;
+    }
+    _alloc_slots[_alloc_slots_used].name = name;
+    return _alloc_slots_used++;
+}
+
+std::vector<alloc_stats_t> alloc_stats()
+{
+    std::lock_guard<std::mutex> lock(_alloc_mutex);
+    std::vector<alloc_stats_t> out;
+    for(int i = 0; i < _alloc_slots_used; ++i) {
+        const alloc_slot_t& s = _alloc_slots[i];
+        out.push_back({s.name, s.calls.load(), s.allocations.load(), s.bytes.load(), s.max_allocations.load()});
+    }
+    return out;
+}
+
+void reset_alloc_stats()
+{
+    std::lock_guard<std::mutex> lock(_alloc_mutex);
+    for(int i = 0; i < _alloc_slots_used; ++i) {
+        alloc_slot_t& s = _alloc_slots[i];
+        s.calls = 0;
+        s.allocations = 0;
+        s.bytes = 0;
+        s.max_allocations = 0;
+    }
+}
+
+alloc_scope_t::alloc_scope_t(std::string_view name)
+    : _slot(_alloc_tracking ? alloc_slot(name) : -1)
+{
+    // after the lookup, which might have allocated the name
+    _allocations = _thread_allocations;
+    _bytes = _thread_bytes;
+}
+
+alloc_scope_t::~alloc_scope_t()
+{
+    if (_slot < 0) {
+        return;
+    }
+    alloc_slot_t& s = _alloc_slots[_slot];
+    const size_t n = _thread_allocations - _allocations;
+    ++s.calls;
+    s.allocations += n;
+    s.bytes += _thread_bytes - _bytes;
+    size_t max = s.max_allocations.load(std::memory_order_relaxed);
+    while (n > max && !s.max_allocations.compare_exchange_weak(max, n)) {
+    }
+}
+
+void* event_arena_t::upstream_t::do_allocate(size_t n, size_t align)
+{
+    bytes += n;
+    return std::pmr::new_delete_resource()->allocate(n, align);
+}
+
+void event_arena_t::upstream_t::do_deallocate(void* p, size_t n, size_t align)
+{
+    std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
+
+bool event_arena_t::upstream_t::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+event_arena_t::event_arena_t(size_t size)
+    : _buffer(size)
+{
+    _mono.emplace(_buffer.data(), _buffer.size(), &_upstream);
+}
+
+void event_arena_t::reset()
+{
+    size_t spilled = _upstream.bytes;
+    _mono.reset();
+    _upstream.bytes = 0;
+    if (spilled) {
+        // make room for the spill-over next time, plus some slack
+        _buffer.resize(_buffer.size() + 2 * spilled);
+    }
+    _mono.emplace(_buffer.data(), _buffer.size(), &_upstream);
+}
+
+void event_arena_t::enter()
+{
+    if (_depth++ == 0) {
+        _enter_allocations = heap_allocations();
+    }
+}
+
+void event_arena_t::leave()
+{
+    if (--_depth == 0) {
+        _last_allocations = heap_allocations() - _enter_allocations;
+        ++_events;
+        reset();
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef _LIBTTWWAM_ARENA_H_
+#define _LIBTTWWAM_ARENA_H_
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// allocations (and bytes) made through the global operator new so far
+size_t heap_allocations();
+size_t heap_bytes();
+// bytes currently allocated, as the allocator sees it (with its rounding)
+size_t heap_live_bytes();
+
+// allocations made while a scope of that name was active on the calling
+// thread. nested scopes count towards their parents as well.
+struct alloc_stats_t {
+    std::string name;
+    size_t calls;
+    size_t allocations;
+    size_t bytes;
+    // most allocations made by a single call
+    size_t max_allocations;
+};
+
+// off by default, scopes cost a lookup when on
+void alloc_tracking(bool on);
+bool alloc_tracking();
+std::vector<alloc_stats_t> alloc_stats();
+void reset_alloc_stats();
+
+class alloc_scope_t {
+public:
+    explicit alloc_scope_t(std::string_view name);
+    ~alloc_scope_t();
+
+    alloc_scope_t(const alloc_scope_t&) = delete;
+    alloc_scope_t& operator=(const alloc_scope_t&) = delete;
+
+private:
+    int _slot;
+    size_t _allocations;
+    size_t _bytes;
+};
+
+// monotonic arena for everything a single UI event needs
+//
+// memory handed out is only ever released in bulk by reset(). if an event
+// needed more than the preallocated buffer, the buffer is grown on reset so
+// that the steady state doesn't touch the global heap at all.
+class event_arena_t {
+public:
+    explicit event_arena_t(size_t size);
+
+    std::pmr::memory_resource* resource() { return &*_mono; }
+
+    void reset();
+
+    // nested scopes share the arena, only the outermost one resets it
+    void enter();
+    void leave();
+
+    size_t capacity() const { return _buffer.size(); }
+    size_t events() const { return _events; }
+    // heap allocations made during the last completed (outermost) event
+    size_t last_allocations() const { return _last_allocations; }
+
+private:
+    // forwards to the global heap and tracks how much spilled over
+    class upstream_t : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void* p, size_t bytes, size_t align) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> _buffer;
+    upstream_t _upstream;
+    std::optional<std::pmr::monotonic_buffer_resource> _mono;
+    int _depth = 0;
+    size_t _events = 0;
+    size_t _enter_allocations = 0;
+    size_t _last_allocations = 0;
+};
+
+class arena_scope_t {
+public:
+    explicit arena_scope_t(event_arena_t& arena)
+        : _arena(arena)
+    {
+        _arena.enter();
+    }
+    ~arena_scope_t()
+    {
+        _arena.leave();
+    }
+    arena_scope_t(const arena_scope_t&) = delete;
+    arena_scope_t& operator=(const arena_scope_t&) = delete;
+
+private:
+    event_arena_t& _arena;
+};
+
+#endif // _LIBTTWWAM_ARENA_H_
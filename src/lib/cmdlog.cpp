@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <unordered_set>
+
+#include "cmdlog.h"
+#include "mapped.h"
+
+using std::wstring;
+using std::wstring_view;
+
+namespace fs = std::filesystem;
+
+static const char CMDLOG_MAGIC[4] = {'T', 'T', 'W', 'L'};
+
+struct cmdlog_header_t {
+    char magic[4];
+    uint32_t version;
+    // logs are only read back where they were written
+    uint32_t wchar_size;
+    uint32_t reserved;
+};
+
+struct cmdlog_record_t {
+    // in wchar_t units
+    uint32_t length;
+    uint32_t checksum;
+};
+
+// FNV-1a
+static uint32_t checksum(wstring_view command)
+{
+    uint32_t h = 2166136261u;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(command.data());
+    for(size_t i = 0; i < command.size() * sizeof(wchar_t); ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static double us_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static fs::path tmp_path(const fs::path& path)
+{
+    fs::path tmp(path);
+    tmp += ".tmp";
+    return tmp;
+}
+
+static void write_header(std::ofstream& out)
+{
+    cmdlog_header_t h = {};
+    std::memcpy(h.magic, CMDLOG_MAGIC, sizeof(h.magic));
+    h.version = CMDLOG_VERSION;
+    h.wchar_size = sizeof(wchar_t);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+static void write_record(std::ofstream& out, wstring_view command)
+{
+    const cmdlog_record_t r = {static_cast<uint32_t>(command.size()), checksum(command)};
+    out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    out.write(reinterpret_cast<const char*>(command.data()), static_cast<std::streamsize>(command.size() * sizeof(wchar_t)));
+}
+
+command_log_t::~command_log_t()
+{
+    close();
+}
+
+void command_log_t::open(const fs::path& path, std::function<void()> compacted)
+{
+    close();
+    _path = path;
+    _compacted = std::move(compacted);
+    _text.clear();
+    _offsets.clear();
+    _stats = cmdlog_stats_t();
+
+    const auto start = std::chrono::steady_clock::now();
+    // the size of what checks out, 0 if it isn't a log at all
+    uint64_t valid = 0;
+    uint64_t size = 0;
+    {
+        mapped_file_t mapped(path);
+        const uint8_t* data = mapped.data();
+        size = mapped.size();
+        _text.reserve(size / sizeof(wchar_t));
+        cmdlog_header_t h;
+        if (size >= sizeof(h)) {
+            std::memcpy(&h, data, sizeof(h));
+        }
+        if (size >= sizeof(h) && !std::memcmp(h.magic, CMDLOG_MAGIC, sizeof(h.magic)) && h.version == CMDLOG_VERSION
+                && h.wchar_size == sizeof(wchar_t)) {
+            valid = sizeof(h);
+            while (size - valid >= sizeof(cmdlog_record_t)) {
+                cmdlog_record_t r;
+                std::memcpy(&r, data + valid, sizeof(r));
+                const uint64_t bytes = static_cast<uint64_t>(r.length) * sizeof(wchar_t);
+                if (bytes > size - valid - sizeof(r)) {
+                    break;
+                }
+                const size_t at = _text.size();
+                _text.resize(at + r.length);
+                std::memcpy(&_text[at], data + valid + sizeof(r), bytes);
+                if (checksum(wstring_view(_text).substr(at)) != r.checksum) {
+                    _text.resize(at);
+                    break;
+                }
+                _offsets.push_back(at);
+                valid += sizeof(r) + bytes;
+            }
+        }
+    }
+    _stats.loaded = _offsets.size();
+    _stats.load_us = us_since(start);
+
+    if (!valid) {
+        // missing or not ours, start over
+        _out.open(path, std::ios::binary | std::ios::trunc);
+        write_header(_out);
+        _out.flush();
+        valid = sizeof(cmdlog_header_t);
+    } else {
+        if (valid < size) {
+            std::error_code ec;
+            fs::resize_file(path, valid, ec);
+        }
+        _out.open(path, std::ios::binary | std::ios::app);
+    }
+    _stats.file_bytes = valid;
+    compact();
+}
+
+void command_log_t::close()
+{
+    if (_compactor.joinable()) {
+        _compactor.join();
+    }
+    if (_result.changed) {
+        std::error_code ec;
+        fs::remove(tmp_path(_path), ec);
+    }
+    _result = compacted_t();
+    _out.close();
+}
+
+void command_log_t::append(wstring_view command)
+{
+    if (command.empty() || (size() && at(size() - 1) == command)) {
+        return;
+    }
+    _offsets.push_back(_text.size());
+    _text.append(command);
+    ++_stats.appended;
+    if (_out.is_open()) {
+        write_record(_out, command);
+        _out.flush();
+        _stats.file_bytes += sizeof(cmdlog_record_t) + command.size() * sizeof(wchar_t);
+    }
+    ++_since_compaction;
+}
+
+wstring_view command_log_t::at(size_t i) const
+{
+    const size_t end = i + 1 < _offsets.size() ? _offsets[i + 1] : _text.size();
+    return wstring_view(_text).substr(_offsets[i], end - _offsets[i]);
+}
+
+size_t command_log_t::search(wstring_view needle, size_t before)
+{
+    const auto start = std::chrono::steady_clock::now();
+    size_t found = size();
+    for(size_t i = std::min(before, size()); i-- > 0;) {
+        if (at(i).find(needle) != wstring_view::npos) {
+            found = i;
+            break;
+        }
+    }
+    _stats.last_search_us = us_since(start);
+    return found;
+}
+
+void command_log_t::compact()
+{
+    // one at a time, and the last one has to be finished first
+    if (_compactor.joinable() || !_out.is_open()) {
+        return;
+    }
+    _since_compaction = 0;
+    _compacting = true;
+    // copies, the entries keep growing meanwhile
+    _compactor = std::thread([this, text = _text, offsets = _offsets, tmp = tmp_path(_path)] {
+        const auto start = std::chrono::steady_clock::now();
+        compacted_t r;
+        r.from = offsets.size();
+        auto entry = [&](size_t i) {
+            const size_t end = i + 1 < offsets.size() ? offsets[i + 1] : text.size();
+            return wstring_view(text).substr(offsets[i], end - offsets[i]);
+        };
+
+        // newest first, the newest occurrence of each
+        std::unordered_set<wstring_view> seen;
+        std::vector<size_t> keep;
+        for(size_t i = offsets.size(); i-- > 0 && keep.size() < CMDLOG_ENTRIES;) {
+            if (seen.insert(entry(i)).second) {
+                keep.push_back(i);
+            }
+        }
+        r.changed = keep.size() != offsets.size();
+        if (r.changed) {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            write_header(out);
+            for(auto it = keep.rbegin(); it != keep.rend(); ++it) {
+                const wstring_view e = entry(*it);
+                r.offsets.push_back(r.text.size());
+                r.text.append(e);
+                write_record(out, e);
+            }
+            r.changed = static_cast<bool>(out);
+        }
+        r.us = us_since(start);
+        _result = std::move(r);
+        _compacting = false;
+        if (_compacted) {
+            _compacted();
+        }
+    });
+}
+
+void command_log_t::finish_compaction()
+{
+    if (!_compactor.joinable()) {
+        return;
+    }
+    _compactor.join();
+    compacted_t r = std::move(_result);
+    _result = compacted_t();
+    ++_stats.compactions;
+    _stats.last_compaction_us = r.us;
+    if (!r.changed) {
+        return;
+    }
+
+    // what ran while it was compacting
+    const fs::path tmp = tmp_path(_path);
+    const size_t kept = r.offsets.size();
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::app);
+        for(size_t i = r.from; i < size(); ++i) {
+            const wstring_view e = at(i);
+            r.offsets.push_back(r.text.size());
+            r.text.append(e);
+            write_record(out, e);
+        }
+        if (!out) {
+            return;
+        }
+    }
+    _out.close();
+    std::error_code ec;
+    fs::rename(tmp, _path, ec);
+    if (!ec) {
+        _stats.dropped += r.from - kept;
+        _text = std::move(r.text);
+        _offsets = std::move(r.offsets);
+        _stats.file_bytes = fs::file_size(_path, ec);
+    }
+    _out.open(_path, std::ios::binary | std::ios::app);
+}
@@ -0,0 +1,104 @@
+#ifndef _LIBTTWWAM_CMDLOG_H_
+#define _LIBTTWWAM_CMDLOG_H_
+
+// the commands typed into the input box, kept across restarts
+//
+// the log is a header followed by records appended as commands run: the
+// length in wchar_t units, a checksum and the units. it's memory mapped
+// once when opened, the first record that doesn't check out (a torn write)
+// ends it and gets cut off. in memory all entries share one buffer, oldest
+// first, so searching even CMDLOG_ENTRIES of them is a scan over
+// contiguous memory.
+//
+// compaction keeps the newest occurrence of every command, at most
+// CMDLOG_ENTRIES. the owner starts it once compaction_due(), when it's idle
+// rather than while running a command. it copies the entries and rewrites
+// the log aside on a background thread, the owner then appends what was
+// run meanwhile and swaps the files.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+const uint32_t CMDLOG_VERSION = 1;
+const size_t CMDLOG_ENTRIES = 100000;
+// appends between compactions
+const size_t CMDLOG_COMPACT_EVERY = 1000;
+
+struct cmdlog_stats_t {
+    size_t loaded = 0;
+    size_t appended = 0;
+    size_t compactions = 0;
+    // entries compactions dropped
+    size_t dropped = 0;
+    uint64_t file_bytes = 0;
+    double load_us = 0;
+    double last_compaction_us = 0;
+    double last_search_us = 0;
+};
+
+class command_log_t {
+public:
+    command_log_t() = default;
+    ~command_log_t();
+
+    command_log_t(const command_log_t&) = delete;
+    command_log_t& operator=(const command_log_t&) = delete;
+
+    // loads `path`, appends to it from then on and compacts it. `compacted`
+    // runs on the compaction thread once it's done, finish_compaction() has
+    // to be called on the owner's thread then.
+    void open(const std::filesystem::path& path, std::function<void()> compacted);
+    // waits for a running compaction and drops it
+    void close();
+
+    // skips empty commands and repeats of the newest one
+    void append(std::wstring_view command);
+    size_t size() const { return _offsets.size(); }
+    // 0 is the oldest
+    std::wstring_view at(size_t i) const;
+    // the newest entry before `before` that contains `needle`, size() if none
+    size_t search(std::wstring_view needle, size_t before);
+
+    void compact();
+    bool compaction_due() const { return _since_compaction >= CMDLOG_COMPACT_EVERY; }
+    // swaps in the compacted log, entry indices change
+    void finish_compaction();
+    bool compacting() const { return _compacting.load(); }
+
+    const cmdlog_stats_t& stats() const { return _stats; }
+
+private:
+    struct compacted_t {
+        std::wstring text;
+        std::vector<size_t> offsets;
+        // entries it was made of
+        size_t from = 0;
+        bool changed = false;
+        double us = 0;
+    };
+
+    std::filesystem::path _path;
+    std::ofstream _out;
+    // entry i is _text[_offsets[i], _offsets[i + 1]), the last one ends
+    // with _text
+    std::wstring _text;
+    std::vector<size_t> _offsets;
+    size_t _since_compaction = 0;
+
+    std::function<void()> _compacted;
+    std::thread _compactor;
+    std::atomic<bool> _compacting{false};
+    compacted_t _result;
+
+    cmdlog_stats_t _stats;
+};
+
+#endif // _LIBTTWWAM_CMDLOG_H_
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <system_error>
+
+#include "config.h"
+#include "intern.h"
+#include "mapped.h"
+
+using std::string;
+using std::string_view;
+using std::wstring;
+using std::wstring_view;
+
+namespace fs = std::filesystem;
+
+rcu_cell_t<config_t> _config;
+config_load_stats_t _config_stats;
+
+// the cache: header, hotkey, alias and ignore records, then the strings as
+// UTF-16 code units. records refer to strings by offset and length in code
+// units, all integers are little endian.
+struct config_header_t {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    uint64_t source_mtime;
+    // of the whole cache
+    uint32_t size;
+    int32_t input_height;
+    uint32_t hotkeys;
+    uint32_t aliases;
+    uint32_t ignore;
+    // offset of the strings, in bytes
+    uint32_t strings;
+};
+
+// hotkeys: a = modifiers, b = key | then << 16. aliases: a, b = the name's offset and
+// length. ignore rules: a = kind. offset, length = the command or text.
+struct config_record_t {
+    uint32_t a;
+    uint32_t b;
+    uint32_t offset;
+    uint32_t length;
+};
+
+static const char CONFIG_MAGIC[4] = {'T', 'T', 'W', 'C'};
+
+const wstring* config_t::hotkey_command(uint32_t modifiers, uint32_t key, uint32_t then) const
+{
+    modifiers &= ~CONFIG_MOD_NOREPEAT;
+    for(const auto& hk: hotkeys) {
+        if ((hk.modifiers & ~CONFIG_MOD_NOREPEAT) == modifiers && hk.key == key && hk.then == then) {
+            return &hk.command;
+        }
+    }
+    return nullptr;
+}
+
+bool config_t::sequence_prefix(uint32_t modifiers, uint32_t key) const
+{
+    modifiers &= ~CONFIG_MOD_NOREPEAT;
+    return std::any_of(hotkeys.begin(), hotkeys.end(), [&](const config_hotkey_t& hk) {
+        return hk.then && (hk.modifiers & ~CONFIG_MOD_NOREPEAT) == modifiers && hk.key == key;
+    });
+}
+
+wstring_view config_t::resolve_alias(wstring_view name) const
+{
+    for(const auto& a: aliases) {
+        if (a.name == name) {
+            return a.command;
+        }
+    }
+    return name;
+}
+
+bool config_t::ignores_processes() const
+{
+    return std::any_of(ignore.begin(), ignore.end(), [](const config_ignore_t& i) {
+        return i.kind == IGNORE_PROCESS;
+    });
+}
+
+bool config_t::ignored(wstring_view cls, wstring_view title, wstring_view process) const
+{
+    for(const auto& i: ignore) {
+        switch (i.kind) {
+            case IGNORE_CLASS:
+                if (cls == i.text) {
+                    return true;
+                }
+                break;
+            case IGNORE_TITLE:
+                if (title.find(i.text) != wstring_view::npos) {
+                    return true;
+                }
+                break;
+            case IGNORE_PROCESS:
+                if (process.size() == i.text.size()
+                        && std::equal(process.begin(), process.end(), i.text.begin(), [](wchar_t a, wchar_t b) {
+                            return static_cast<wchar_t>(std::towlower(a)) == b;
+                        })) {
+                    return true;
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+static wstring from_utf8(string_view s)
+{
+    wstring out;
+    out.reserve(s.size());
+    for(size_t i = 0; i < s.size();) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        uint32_t cp;
+        size_t n;
+        if (c < 0x80) {
+            cp = c;
+            n = 1;
+        } else if ((c & 0xe0) == 0xc0) {
+            cp = c & 0x1f;
+            n = 2;
+        } else if ((c & 0xf0) == 0xe0) {
+            cp = c & 0x0f;
+            n = 3;
+        } else if ((c & 0xf8) == 0xf0) {
+            cp = c & 0x07;
+            n = 4;
+        } else {
+            cp = 0xfffd;
+            n = 1;
+        }
+        if (i + n > s.size()) {
+            cp = 0xfffd;
+            n = s.size() - i;
+        } else {
+            for(size_t k = 1; k < n; ++k) {
+                cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3f);
+            }
+        }
+        i += n;
+        if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+            cp -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xd800 + (cp >> 10)));
+            out.push_back(static_cast<wchar_t>(0xdc00 + (cp & 0x3ff)));
+        } else {
+            out.push_back(static_cast<wchar_t>(cp));
+        }
+    }
+    return out;
+}
+
+static void trim(string_view& s)
+{
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+}
+
+// the first word of `s`, which is left with the rest
+static string_view next_word(string_view& s)
+{
+    trim(s);
+    size_t n = 0;
+    while (n < s.size() && !std::isspace(static_cast<unsigned char>(s[n]))) {
+        ++n;
+    }
+    string_view word = s.substr(0, n);
+    s.remove_prefix(n);
+    trim(s);
+    return word;
+}
+
+static string lower(string_view s)
+{
+    string out(s);
+    for(char& c: out) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return out;
+}
+
+uint32_t config_key_code(string_view name)
+{
+    static const struct {
+        const char* name;
+        uint32_t key;
+    } keys[] = {
+        {"backspace", 0x08}, {"tab", 0x09}, {"enter", 0x0d}, {"return", 0x0d}, {"pause", 0x13},
+        {"escape", 0x1b}, {"esc", 0x1b}, {"space", 0x20}, {"pageup", 0x21}, {"pagedown", 0x22},
+        {"end", 0x23}, {"home", 0x24}, {"left", 0x25}, {"up", 0x26}, {"right", 0x27}, {"down", 0x28},
+        {"insert", 0x2d}, {"delete", 0x2e},
+    };
+    const string n = lower(name);
+    if (n.size() == 1 && std::isalnum(static_cast<unsigned char>(n[0]))) {
+        return static_cast<uint32_t>(std::toupper(static_cast<unsigned char>(n[0])));
+    }
+    const bool function_key = n.size() >= 2 && n[0] == 'f' && std::all_of(n.begin() + 1, n.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) != 0;
+    });
+    if (function_key) {
+        int f = std::atoi(n.c_str() + 1);
+        return f >= 1 && f <= 24 ? 0x70 + f - 1 : 0;
+    }
+    for(const auto& k: keys) {
+        if (n == k.name) {
+            return k.key;
+        }
+    }
+    return 0;
+}
+
+// "ctrl+alt+w", optionally followed by ",<key>"
+static bool parse_hotkey(string_view s, uint32_t& modifiers, uint32_t& key, uint32_t& then)
+{
+    modifiers = CONFIG_MOD_NOREPEAT;
+    key = 0;
+    then = 0;
+    const size_t comma = s.find(',');
+    if (comma != string_view::npos) {
+        then = config_key_code(s.substr(comma + 1));
+        if (!then) {
+            return false;
+        }
+        s = s.substr(0, comma);
+    }
+    while (!s.empty()) {
+        size_t plus = s.find('+');
+        string_view part = s.substr(0, plus);
+        s.remove_prefix(plus == string_view::npos ? s.size() : plus + 1);
+        const string p = lower(part);
+        if (p == "ctrl" || p == "control") {
+            modifiers |= CONFIG_MOD_CONTROL;
+        } else if (p == "alt") {
+            modifiers |= CONFIG_MOD_ALT;
+        } else if (p == "shift") {
+            modifiers |= CONFIG_MOD_SHIFT;
+        } else if (p == "win") {
+            modifiers |= CONFIG_MOD_WIN;
+        } else if (!key) {
+            key = config_key_code(part);
+            if (!key) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return key != 0;
+}
+
+void parse_config(string_view text, config_t& out, std::vector<wstring>& errors)
+{
+    size_t number = 0;
+    while (!text.empty()) {
+        size_t eol = text.find('\n');
+        string_view line = text.substr(0, eol);
+        text.remove_prefix(eol == string_view::npos ? text.size() : eol + 1);
+        ++number;
+        trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto error = [&](const char* msg) {
+            errors.push_back(L"line " + std::to_wstring(number) + L": " + from_utf8(msg));
+        };
+        string_view rest = line;
+        const string_view what = next_word(rest);
+        if (what == "input_height") {
+            int h = std::atoi(string(rest).c_str());
+            if (h <= 0) {
+                error("input_height needs a positive number");
+                continue;
+            }
+            out.input_height = h;
+        } else if (what == "bind" || what == "unbind") {
+            uint32_t modifiers, key, then;
+            string_view keys = next_word(rest);
+            if (!parse_hotkey(keys, modifiers, key, then)) {
+                error("unknown hotkey");
+                continue;
+            }
+            auto it = std::remove_if(out.hotkeys.begin(), out.hotkeys.end(), [&](const config_hotkey_t& hk) {
+                return hk.modifiers == modifiers && hk.key == key && hk.then == then;
+            });
+            out.hotkeys.erase(it, out.hotkeys.end());
+            if (what == "unbind") {
+                continue;
+            }
+            if (rest.empty()) {
+                error("bind needs a command");
+                continue;
+            }
+            out.hotkeys.push_back({modifiers, key, from_utf8(rest), then});
+        } else if (what == "alias") {
+            string_view name = next_word(rest);
+            if (name.empty() || rest.empty()) {
+                error("alias needs a name and a command");
+                continue;
+            }
+            out.aliases.push_back({from_utf8(name), from_utf8(rest)});
+        } else if (what == "ignore") {
+            string_view kind = next_word(rest);
+            config_ignore_t i;
+            if (kind == "class") {
+                i.kind = IGNORE_CLASS;
+            } else if (kind == "title") {
+                i.kind = IGNORE_TITLE;
+            } else if (kind == "process") {
+                i.kind = IGNORE_PROCESS;
+            } else {
+                error("ignore class, title or process");
+                continue;
+            }
+            if (rest.empty()) {
+                error("ignore needs a text");
+                continue;
+            }
+            wstring t = from_utf8(rest);
+            if (i.kind == IGNORE_PROCESS) {
+                string_pool_t::to_lower(t, i.text);
+            } else {
+                i.text = std::move(t);
+            }
+            out.ignore.push_back(std::move(i));
+        } else {
+            error("unknown setting");
+        }
+    }
+}
+
+// UTF-16 in the cache, whatever wchar_t is
+static uint32_t append_string(std::u16string& strings, wstring_view s)
+{
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    for(wchar_t ch: s) {
+        uint32_t cp = static_cast<uint32_t>(ch);
+        if (sizeof(wchar_t) == 4 && cp >= 0x10000) {
+            cp -= 0x10000;
+            strings.push_back(static_cast<char16_t>(0xd800 + (cp >> 10)));
+            strings.push_back(static_cast<char16_t>(0xdc00 + (cp & 0x3ff)));
+        } else {
+            strings.push_back(static_cast<char16_t>(cp));
+        }
+    }
+    return offset;
+}
+
+static wstring read_string(const char16_t* strings, uint32_t offset, uint32_t length)
+{
+    wstring out;
+    out.reserve(length);
+    for(uint32_t i = 0; i < length; ++i) {
+        uint32_t cp = strings[offset + i];
+        if (sizeof(wchar_t) == 4 && cp >= 0xd800 && cp < 0xdc00 && i + 1 < length) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (strings[offset + ++i] - 0xdc00);
+        }
+        out.push_back(static_cast<wchar_t>(cp));
+    }
+    return out;
+}
+
+std::string compile_config(const config_t& config, uint64_t size, uint64_t mtime)
+{
+    std::vector<config_record_t> records;
+    std::u16string strings;
+    for(const auto& hk: config.hotkeys) {
+        uint32_t offset = append_string(strings, hk.command);
+        records.push_back({hk.modifiers, hk.key | hk.then << 16, offset, static_cast<uint32_t>(strings.size() - offset)});
+    }
+    for(const auto& a: config.aliases) {
+        uint32_t name = append_string(strings, a.name);
+        uint32_t name_length = static_cast<uint32_t>(strings.size() - name);
+        uint32_t offset = append_string(strings, a.command);
+        records.push_back({name, name_length, offset, static_cast<uint32_t>(strings.size() - offset)});
+    }
+    for(const auto& i: config.ignore) {
+        uint32_t offset = append_string(strings, i.text);
+        records.push_back({i.kind, 0, offset, static_cast<uint32_t>(strings.size() - offset)});
+    }
+
+    config_header_t h = {};
+    std::memcpy(h.magic, CONFIG_MAGIC, sizeof(h.magic));
+    h.version = CONFIG_VERSION;
+    h.source_size = size;
+    h.source_mtime = mtime;
+    h.input_height = config.input_height;
+    h.hotkeys = static_cast<uint32_t>(config.hotkeys.size());
+    h.aliases = static_cast<uint32_t>(config.aliases.size());
+    h.ignore = static_cast<uint32_t>(config.ignore.size());
+    h.strings = static_cast<uint32_t>(sizeof(h) + records.size() * sizeof(config_record_t));
+    h.size = static_cast<uint32_t>(h.strings + strings.size() * sizeof(char16_t));
+
+    string out(h.size, '\0');
+    std::memcpy(&out[0], &h, sizeof(h));
+    if (!records.empty()) {
+        std::memcpy(&out[sizeof(h)], records.data(), records.size() * sizeof(config_record_t));
+    }
+    if (!strings.empty()) {
+        std::memcpy(&out[h.strings], strings.data(), strings.size() * sizeof(char16_t));
+    }
+    return out;
+}
+
+bool decode_config(const uint8_t* data, size_t size, uint64_t source_size, uint64_t source_mtime, config_t& out)
+{
+    config_header_t h;
+    if (size < sizeof(h)) {
+        return false;
+    }
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, CONFIG_MAGIC, sizeof(h.magic)) || h.version != CONFIG_VERSION || h.size != size
+            || h.source_size != source_size || h.source_mtime != source_mtime) {
+        return false;
+    }
+    const uint64_t n = static_cast<uint64_t>(h.hotkeys) + h.aliases + h.ignore;
+    if (h.strings != sizeof(h) + n * sizeof(config_record_t) || h.strings > size || (size - h.strings) % 2) {
+        return false;
+    }
+    std::vector<config_record_t> records(n);
+    if (n) {
+        std::memcpy(records.data(), data + sizeof(h), n * sizeof(config_record_t));
+    }
+    const uint64_t units = (size - h.strings) / 2;
+    std::u16string strings(units, u'\0');
+    if (units) {
+        std::memcpy(&strings[0], data + h.strings, units * 2);
+    }
+    auto in_range = [units](uint32_t offset, uint32_t length) {
+        return static_cast<uint64_t>(offset) + length <= units;
+    };
+    for(const auto& r: records) {
+        if (!in_range(r.offset, r.length)) {
+            return false;
+        }
+    }
+
+    config_t c;
+    c.input_height = h.input_height;
+    c.hotkeys.clear();
+    size_t i = 0;
+    for(uint32_t k = 0; k < h.hotkeys; ++k, ++i) {
+        const config_record_t& r = records[i];
+        c.hotkeys.push_back({r.a, r.b & 0xffff, read_string(strings.data(), r.offset, r.length), r.b >> 16});
+    }
+    for(uint32_t k = 0; k < h.aliases; ++k, ++i) {
+        const config_record_t& r = records[i];
+        if (!in_range(r.a, r.b)) {
+            return false;
+        }
+        c.aliases.push_back({read_string(strings.data(), r.a, r.b), read_string(strings.data(), r.offset, r.length)});
+    }
+    for(uint32_t k = 0; k < h.ignore; ++k, ++i) {
+        const config_record_t& r = records[i];
+        if (r.a > IGNORE_PROCESS) {
+            return false;
+        }
+        c.ignore.push_back({static_cast<config_ignore_kind_t>(r.a), read_string(strings.data(), r.offset, r.length)});
+    }
+    out = std::move(c);
+    return true;
+}
+
+fs::path config_cache_path(const fs::path& path)
+{
+    fs::path cache(path);
+    cache += ".bin";
+    return cache;
+}
+
+static double us_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void load_config(const fs::path& path, config_t& out, config_load_stats_t& stats)
+{
+    stats = config_load_stats_t();
+    out = config_t();
+    std::error_code ec;
+    const uint64_t size = fs::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    const uint64_t mtime = static_cast<uint64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+    if (ec) {
+        return;
+    }
+    const fs::path cache = config_cache_path(path);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        mapped_file_t mapped(cache);
+        stats.map_us = us_since(start);
+        start = std::chrono::steady_clock::now();
+        if (mapped.data() && decode_config(mapped.data(), mapped.size(), size, mtime, out)) {
+            stats.decode_us = us_since(start);
+            stats.from_cache = true;
+            return;
+        }
+    }
+
+    start = std::chrono::steady_clock::now();
+    std::ifstream f(path, std::ios::binary);
+    string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (!f && !f.eof()) {
+        stats.errors.push_back(L"can't read the configuration");
+        return;
+    }
+    parse_config(text, out, stats.errors);
+    stats.parse_us = us_since(start);
+    // keep reporting the errors until they're fixed
+    if (!stats.errors.empty()) {
+        return;
+    }
+
+    // written aside and renamed, readers never see half a cache
+    const string bytes = compile_config(out, size, mtime);
+    fs::path tmp(cache);
+    tmp += ".tmp";
+    {
+        std::ofstream o(tmp, std::ios::binary | std::ios::trunc);
+        o.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!o) {
+            return;
+        }
+    }
+    fs::rename(tmp, cache, ec);
+    stats.cache_written = !ec;
+}
+
+void reload_config(const fs::path& path, config_load_stats_t& stats)
+{
+    std::unique_ptr<config_t> c(new config_t());
+    load_config(path, *c, stats);
+    const auto start = std::chrono::steady_clock::now();
+    _config.publish(std::move(c));
+    stats.swap_us = us_since(start);
+}
@@ -0,0 +1,118 @@
+#ifndef _LIBTTWWAM_CONFIG_H_
+#define _LIBTTWWAM_CONFIG_H_
+
+// the configuration file, a line per setting:
+//
+//   # comment
+//   input_height 25
+//   bind ctrl+alt+w web          runs the command line on the hotkey
+//   bind ctrl+space,w web        or on a key following the hotkey
+//   unbind ctrl+up               drops a (default) binding
+//   alias :s :switch             another name for a command
+//   ignore class|title|process <text>
+//
+// titles match as substrings, classes exactly and processes by their
+// executable's name, ignoring case. the file is compiled into a binary
+// cache next to it, which is memory mapped and used as long as the file's
+// size and modification time match, so unchanged configurations are never
+// parsed again. the active configuration is swapped as a whole (RCU), the
+// scanner threads read the ignore rules without locking.
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rcu.h"
+
+const uint32_t CONFIG_VERSION = 2;
+
+// same values as win32's MOD_*
+const uint32_t CONFIG_MOD_ALT = 0x0001;
+const uint32_t CONFIG_MOD_CONTROL = 0x0002;
+const uint32_t CONFIG_MOD_SHIFT = 0x0004;
+const uint32_t CONFIG_MOD_WIN = 0x0008;
+const uint32_t CONFIG_MOD_NOREPEAT = 0x4000;
+
+enum config_ignore_kind_t : uint32_t {
+    IGNORE_CLASS,
+    IGNORE_TITLE,
+    IGNORE_PROCESS,
+};
+
+struct config_hotkey_t {
+    uint32_t modifiers;
+    // a win32 virtual key code
+    uint32_t key;
+    std::wstring command;
+    // the key that has to follow, without modifiers. 0 for plain hotkeys.
+    uint32_t then = 0;
+};
+
+struct config_alias_t {
+    std::wstring name;
+    std::wstring command;
+};
+
+struct config_ignore_t {
+    config_ignore_kind_t kind;
+    // lowercase for processes
+    std::wstring text;
+};
+
+struct config_t {
+    int32_t input_height = 25;
+    std::vector<config_hotkey_t> hotkeys = {
+        {CONFIG_MOD_CONTROL | CONFIG_MOD_NOREPEAT, 0x26 /* VK_UP */, L":show_main_window"},
+    };
+    std::vector<config_alias_t> aliases;
+    std::vector<config_ignore_t> ignore;
+
+    // the command line bound to the hotkey (followed by `then`), or null
+    const std::wstring* hotkey_command(uint32_t modifiers, uint32_t key, uint32_t then = 0) const;
+    // whether the hotkey starts a sequence
+    bool sequence_prefix(uint32_t modifiers, uint32_t key) const;
+    // `name` if it isn't an alias
+    std::wstring_view resolve_alias(std::wstring_view name) const;
+    bool ignores_processes() const;
+    // `process` only needs to be set if ignores_processes()
+    bool ignored(std::wstring_view cls, std::wstring_view title, std::wstring_view process) const;
+};
+
+// what the last load did
+struct config_load_stats_t {
+    bool from_cache = false;
+    bool cache_written = false;
+    // mapping the cache, checking and decoding it, parsing the source
+    double map_us = 0;
+    double decode_us = 0;
+    double parse_us = 0;
+    double swap_us = 0;
+    std::vector<std::wstring> errors;
+};
+
+// the active configuration, null until the first load
+extern rcu_cell_t<config_t> _config;
+// of the load that published it, kept by whoever applies it
+extern config_load_stats_t _config_stats;
+
+// parses `text` (UTF-8) on top of the defaults, lines that don't parse are
+// skipped and reported in `errors`
+void parse_config(std::string_view text, config_t& out, std::vector<std::wstring>& errors);
+// the binary form. `size` and `mtime` identify the source it was compiled from.
+std::string compile_config(const config_t& config, uint64_t size, uint64_t mtime);
+// false if `data` isn't a valid cache for a source of that size and mtime
+bool decode_config(const uint8_t* data, size_t size, uint64_t source_size, uint64_t source_mtime, config_t& out);
+// where the cache of `path` goes
+std::filesystem::path config_cache_path(const std::filesystem::path& path);
+// the cache if it's valid, otherwise parses `path` and rewrites the cache
+// unless it had errors. a missing file yields the defaults.
+void load_config(const std::filesystem::path& path, config_t& out, config_load_stats_t& stats);
+// loads and publishes it in _config
+void reload_config(const std::filesystem::path& path, config_load_stats_t& stats);
+
+// the key code for names like "up", "f5", "a", "0" or "space", 0 if unknown
+uint32_t config_key_code(std::string_view name);
+
+#endif // _LIBTTWWAM_CONFIG_H_
@@ -0,0 +1,1447 @@
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "config.h"
+#include "core.h"
+#include "geometry.h"
+#include "history.h"
+#include "idle.h"
+#include "pool.h"
+#include "status.h"
+#include "throttle.h"
+#include "trace.h"
+
+using std::make_shared;
+using std::map;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+using std::weak_ptr;
+using std::wstring;
+using std::wstring_view;
+
+const unsigned SCAN_INTERVAL_MS = 1000;
+// windows the prune job checks per step
+const size_t PRUNE_BATCH = 32;
+// windows that don't answer within that time keep their previous values
+const unsigned HARVEST_DEADLINE_MS = 150;
+// harvesting mostly waits for other processes, and a hung window holds on
+// to its worker until it answers, so not just one per core
+const size_t HARVEST_MIN_THREADS = 4;
+
+string_pool_t _strings;
+event_arena_t _arena(64 * 1024);
+
+container_map_t _containers;
+monitor_map_t _monitors;
+topology_t _topology;
+
+layout_stats_t _layout_total;
+layout_stats_t _layout_last;
+
+hide_stats_t _hide_stats[HIDE_STRATEGIES];
+double _last_switch_us = 0;
+static hide_strategy_t _default_hide_strategy = HIDE_SHOW_WINDOW;
+static map<atom_t, hide_strategy_t> _class_hide_strategies;
+
+rcu_cell_t<desktop_snapshot_t> _snapshot;
+static std::atomic<uint64_t> _snapshot_generation{0};
+static std::atomic<uint64_t> _scans_started{0};
+uint64_t _applied_generation = 0;
+uint64_t _applied_scan = 0;
+scanner_t _scanner;
+
+static winsys_t* _ws = nullptr;
+static hwnd_t _main_window = nullptr;
+// focused before the frontend's window was shown
+static hwnd_t _focus_before = nullptr;
+static hwnd_t _switched_focus = nullptr;
+
+// odd while the GUI thread shows, hides or moves windows, snapshots taken
+// across such a change don't reflect a stable layout and are dropped
+static std::atomic<uint64_t> _layout_epoch{0};
+
+struct layout_change_t {
+    layout_change_t() { ++_layout_epoch; }
+    ~layout_change_t() { ++_layout_epoch; }
+};
+
+// where the prune job continues
+static atom_t _prune_container = NO_ATOM;
+static hwnd_t _prune_window = nullptr;
+
+static std::atomic<trace_writer_t*> _trace{nullptr};
+// only the outermost event of a thread is recorded, the nested ones are
+// replayed as part of it
+thread_local int _trace_depth = 0;
+
+// also the allocation scope of the event
+class traced_event_t {
+public:
+    explicit traced_event_t(uint8_t op)
+        : _alloc(trace_op_name(op)), _op(op), _writer(_trace_depth++ == 0 ? _trace.load() : nullptr)
+    {
+        if (_writer) {
+            _start = _writer->now();
+        }
+    }
+
+    traced_event_t(uint8_t op, wstring_view arg)
+        : traced_event_t(op)
+    {
+        if (_writer) {
+            _rec.str(arg);
+        }
+    }
+
+    void u(uint64_t v)
+    {
+        if (_writer) {
+            _rec.u(v);
+        }
+    }
+
+    void str(wstring_view v)
+    {
+        if (_writer) {
+            _rec.str(v);
+        }
+    }
+
+    ~traced_event_t()
+    {
+        --_trace_depth;
+        if (_writer) {
+            _writer->write(_op, _start, _rec);
+        }
+    }
+
+private:
+    alloc_scope_t _alloc;
+    uint8_t _op;
+    trace_writer_t* _writer;
+    uint64_t _start = 0;
+    trace_record_t _rec;
+};
+
+static void add_core_jobs();
+
+void core_init(winsys_t* ws, hwnd_t main_window)
+{
+    _ws = ws;
+    _main_window = main_window;
+    add_core_jobs();
+}
+
+void core_reset()
+{
+    _containers.clear();
+    _monitors.clear();
+    _topology.clear();
+    _layout_total = layout_stats_t();
+    _layout_last = layout_stats_t();
+    for(auto& st: _hide_stats) {
+        st = hide_stats_t();
+    }
+    _last_switch_us = 0;
+    _class_hide_strategies.clear();
+    throttle_reset();
+    _focus_before = nullptr;
+    _switched_focus = nullptr;
+    _snapshot.publish(unique_ptr<desktop_snapshot_t>());
+    _applied_generation = 0;
+    _applied_scan = 0;
+    _strings = string_pool_t();
+    history_reset();
+    _prune_container = NO_ATOM;
+    _prune_window = nullptr;
+    idle_reset();
+}
+
+void core_trace(trace_writer_t* trace)
+{
+    _trace = trace;
+}
+
+void trace_input(wstring_view what)
+{
+    traced_event_t event(TRACE_INPUT, what);
+}
+
+winsys_t& winsys()
+{
+    return *_ws;
+}
+
+template<>
+wstring _w<rect_t>(rect_t r)
+{
+    std::wstringstream ss;
+    ss << "("
+        << r.left << ","
+        << r.top << ")-("
+        << r.right << ","
+        << r.bottom << ")";
+    return ss.str();
+}
+
+template<>
+wstring _w<drect_t>(drect_t r)
+{
+    std::wstringstream ss;
+    ss << "("
+        << r.left << ","
+        << r.top << ")-("
+        << r.right << ","
+        << r.bottom << ")";
+    return ss.str();
+}
+
+rect_t monitor_t::get_absolute_window_rect(const window_t& window) const
+{
+    // rounded like the batch version, so that converting back and forth
+    // gives the very same rect
+    const rect_transform_t t = absolute_on(info.rect);
+    const drect_t& in = window.rect;
+    rect_t out;
+    out.left = convert_coordinate<int32_t>(in.left * t.sx + t.ox);
+    out.right = convert_coordinate<int32_t>(in.right * t.sx + t.ox);
+    out.top = convert_coordinate<int32_t>(in.top * t.sy + t.oy);
+    out.bottom = convert_coordinate<int32_t>(in.bottom * t.sy + t.oy);
+    return out;
+}
+
+// absolute rects of all windows of `c` placed on `monitor`, in wmap order.
+// GUI thread only, the buffers are reused.
+static const rect_array_t<int32_t>& container_rects_on(const container_t& c, const rect_t& monitor)
+{
+    static rect_array_t<double> relative;
+    static rect_array_t<int32_t> absolute;
+    relative.clear();
+    for(const auto& e: c.wmap) {
+        const drect_t& r = e.second.rect;
+        relative.push_back(r.left, r.top, r.right, r.bottom);
+    }
+    transform_rects(relative, absolute_on(monitor), absolute);
+    return absolute;
+}
+
+// moves the windows of `c` to their places on `monitor`
+static void place_container(container_t& c, const rect_t& monitor)
+{
+    const rect_array_t<int32_t>& rects = container_rects_on(c, monitor);
+    size_t i = 0;
+    for(auto& e: c.wmap) {
+        place_window(e.second, {rects.left[i], rects.top[i], rects.right[i], rects.bottom[i]});
+        ++i;
+    }
+}
+
+wstring monitor_t::tostr() const
+{
+    wstring txt;
+    txt.append(_w(info.rect));
+    txt.append(L" HMONITOR=");
+    txt.append(_w(hmon));
+    txt.append(L", Name=");
+    txt.append(info.device);
+    txt.append(L", DPI=");
+    txt.append(_w(info.dpi));
+    return txt;
+}
+
+monitor_t get_monitor_info(hmonitor_t hmon)
+{
+    monitor_t mon = {};
+    mon.hmon = hmon;
+    mon.valid = true;
+    if (!_ws->monitor_info(hmon, mon.info)) {
+        mon.valid = false;
+    }
+    return mon;
+}
+
+hmonitor_t current_monitor_handle()
+{
+    return _ws->cursor_monitor();
+}
+
+monitor_t current_monitor()
+{
+    return get_monitor_info(current_monitor_handle());
+}
+
+wstring window_t::tostr() const {
+    wstring txt;
+    txt.append(_w(rect));
+    txt.append(L" ");
+    txt.append(_w(current_monitor().get_absolute_window_rect(*this)));
+    txt.append(L" ");
+    txt.append(L" HWND=");
+    txt.append(_w(hwnd));
+    txt.append(L" ");
+    txt.append(L" Title=");
+    txt.append(_strings.str(title));
+    return txt;
+}
+
+wstring container_t::tostr() const {
+    wstring txt;
+    txt.append(_strings.str(name));
+    txt.append(NL);
+    for(const auto& it: wmap)
+    {
+        txt.append(it.second.tostr());
+        txt.append(NL);
+    }
+    return txt;
+}
+
+shared_ptr<container_t> current_container()
+{
+    hmonitor_t hmon = current_monitor_handle();
+    return _monitors[hmon].lock();
+}
+
+static void count_layout_op(size_t layout_stats_t::*op)
+{
+    ++(_layout_total.*op);
+    ++(_layout_last.*op);
+}
+
+const wchar_t* hide_strategy_name(hide_strategy_t strategy)
+{
+    switch (strategy) {
+        case HIDE_SHOW_WINDOW: return L"hide";
+        case HIDE_CLOAK: return L"cloak";
+        default: return L"?";
+    }
+}
+
+void set_hide_strategy(wstring_view cls, hide_strategy_t strategy)
+{
+    if (cls.empty()) {
+        _default_hide_strategy = strategy;
+    } else {
+        _class_hide_strategies[_strings.intern(cls)] = strategy;
+    }
+}
+
+hide_strategy_t hide_strategy(atom_t cls)
+{
+    const auto it = _class_hide_strategies.find(cls);
+    return it != _class_hide_strategies.end() ? it->second : _default_hide_strategy;
+}
+
+void show_hide_window(window_t& window, bool show)
+{
+    if (window.shown == show) {
+        count_layout_op(&layout_stats_t::skipped);
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    hide_strategy_t strategy = show ? window.hidden_by : hide_strategy(window.cls);
+    if (strategy == HIDE_CLOAK && !_ws->cloak_window(window.hwnd, !show)) {
+        // DWM refuses to cloak windows of other processes, don't bother
+        // trying again for this class
+        wstring txt(L"can't cloak windows of class ");
+        txt.append(_strings.str(window.cls));
+        txt.append(L", hiding them instead");
+        log_debug(txt);
+        _class_hide_strategies[window.cls] = HIDE_SHOW_WINDOW;
+        strategy = HIDE_SHOW_WINDOW;
+    }
+    if (strategy == HIDE_SHOW_WINDOW) {
+        _ws->show_window(window.hwnd, show);
+    }
+    window.shown = show;
+    if (!show) {
+        window.hidden_by = strategy;
+    }
+    count_layout_op(show ? &layout_stats_t::shown : &layout_stats_t::hidden);
+
+    hide_stats_t& st = _hide_stats[strategy];
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    ++st.calls;
+    st.total_us += us;
+    st.max_us = std::max(st.max_us, us);
+}
+
+void place_window(window_t& window, const rect_t& r)
+{
+    // a minimized window's rect is the placeholder far off screen, it gets
+    // restored to wherever it was before
+    if (window.show == WINDOW_MINIMIZED || same_rect(window.placed, r)) {
+        count_layout_op(&layout_stats_t::skipped);
+        return;
+    }
+    _ws->move_window(window.hwnd, r);
+    window.placed = r;
+    count_layout_op(&layout_stats_t::moved);
+}
+
+bool ignore_window(hwnd_t hwnd)
+{
+    if (_ws->shell_window() == hwnd) {
+        return true;
+    }
+    if (hwnd == _main_window) {
+        return true;
+    }
+    if (!_ws->is_visible(hwnd)) {
+        return true;
+    }
+    if (!_ws->title_length(hwnd)) {
+        return true;
+    }
+    return false;
+}
+
+shared_ptr<container_t> find_container(wstring_view name)
+{
+    atom_t id = _strings.find(name);
+    if (!id) {
+        return shared_ptr<container_t>();
+    }
+    auto it = _containers.find(id);
+    if (it == _containers.end()) {
+        return shared_ptr<container_t>();
+    }
+    return it->second;
+}
+
+wstring new_container_name() {
+    int i = 0;
+    wstring name;
+    if (_containers.empty()) {
+        return L"main";
+    }
+    do {
+        ++i;
+        name =  L"cont " + _w(i);
+    } while(find_container(name));
+    return name;
+}
+
+shared_ptr<container_t> new_container(wstring_view name)
+{
+    wstring generated;
+    if (name.empty()) {
+        generated = new_container_name();
+        name = generated;
+    }
+    atom_t id = _strings.intern(name);
+    if (_containers.find(id) != _containers.end()) {
+        return shared_ptr<container_t>();
+    }
+    shared_ptr<container_t> c = make_shared<container_t>(id);
+    _containers[id] = c;
+    return c;
+}
+
+bool delete_container(shared_ptr<container_t> c)
+{
+    if (!c) {
+        return false;
+    }
+
+    _containers.erase(c->name);
+    publish_status();
+    return true;
+}
+
+// scans are done in two phases: enumeration only collects the handles, the
+// per window attributes (some of which need the owning process to answer)
+// are harvested in parallel into a preallocated array.
+enum harvest_state_t {
+    HARVEST_PENDING,
+    HARVEST_RUNNING,
+    HARVEST_DONE,
+    HARVEST_IGNORED,
+    // deadline passed before any worker picked it up, or the window was
+    // still hung
+    HARVEST_ABANDONED,
+};
+
+// windows a worker was still stuck on when a scan's deadline passed. later
+// scans serve them from the previous snapshot instead of tying up another
+// worker, until the stuck call returns.
+static std::mutex _hung_mutex;
+static std::unordered_set<hwnd_t> _hung;
+static std::atomic<bool> _any_hung{false};
+
+static void window_answered(hwnd_t hwnd)
+{
+    std::lock_guard<std::mutex> lock(_hung_mutex);
+    _hung.erase(hwnd);
+    _any_hung = !_hung.empty();
+}
+
+size_t hung_windows()
+{
+    std::lock_guard<std::mutex> lock(_hung_mutex);
+    return _hung.size();
+}
+
+// shared with the workers, which may still be busy with slow windows after
+// the scan has moved on
+struct harvest_t {
+    vector<hwnd_t> handles;
+    vector<window_info_t> results;
+    unique_ptr<std::atomic<int>[]> state;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> finished{0};
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+worker_pool_t& harvest_pool()
+{
+    // never destroyed, a worker might hang on an unresponsive window at exit
+    static worker_pool_t* pool = new worker_pool_t(std::max<size_t>(std::thread::hardware_concurrency(),
+                HARVEST_MIN_THREADS));
+    return *pool;
+}
+
+bool harvest_window(hwnd_t hwnd, window_info_t& w)
+{
+    if (ignore_window(hwnd)) {
+        return false;
+    }
+
+    w.hwnd = hwnd;
+    w.hmon = _ws->window_monitor(hwnd);
+    if (!w.hmon) {
+        return false;
+    }
+    _ws->window_rect(hwnd, w.rect);
+    w.show = _ws->window_show_state(hwnd);
+    _ws->title(hwnd, w.title);
+    _ws->window_class(hwnd, w.cls);
+    w.pid = _ws->window_process(hwnd);
+    return true;
+}
+
+void harvest_windows(shared_ptr<harvest_t> h)
+{
+    const size_t n = h->handles.size();
+    for(;;) {
+        size_t i = h->next++;
+        if (i >= n) {
+            break;
+        }
+        int expected = HARVEST_PENDING;
+        if (!h->state[i].compare_exchange_strong(expected, HARVEST_RUNNING)) {
+            continue;
+        }
+        bool ok = harvest_window(h->handles[i], h->results[i]);
+        // sequentially consistent, like the check of the scan that gave up
+        // on it (see build_snapshot())
+        h->state[i].store(ok ? HARVEST_DONE : HARVEST_IGNORED);
+        if (_any_hung) {
+            window_answered(h->handles[i]);
+        }
+        if (++h->finished == n) {
+            std::lock_guard<std::mutex> lock(h->mutex);
+            h->done.notify_one();
+        }
+    }
+}
+
+unique_ptr<desktop_snapshot_t> build_snapshot()
+{
+    traced_event_t event(TRACE_BUILD);
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(HARVEST_DEADLINE_MS);
+
+    unique_ptr<desktop_snapshot_t> snap(new desktop_snapshot_t());
+    snap->scan = ++_scans_started;
+    snap->epoch = _layout_epoch.load();
+    snap->stale = 0;
+
+    vector<hmonitor_t> monitors;
+    _ws->enum_monitors(monitors);
+    for(hmonitor_t hmon: monitors) {
+        snap->monitors[hmon] = get_monitor_info(hmon);
+    }
+
+    shared_ptr<harvest_t> h = make_shared<harvest_t>();
+    _ws->enum_windows(h->handles);
+    const size_t n = h->handles.size();
+    h->results.resize(n);
+    h->state.reset(new std::atomic<int>[n]);
+    for(size_t i = 0; i < n; ++i) {
+        h->state[i].store(HARVEST_PENDING, std::memory_order_relaxed);
+    }
+    if (_any_hung) {
+        std::lock_guard<std::mutex> lock(_hung_mutex);
+        // the ones that are gone won't answer anymore
+        std::unordered_set<hwnd_t> present(h->handles.begin(), h->handles.end());
+        for(auto it = _hung.begin(); it != _hung.end();) {
+            it = present.count(*it) ? std::next(it) : _hung.erase(it);
+        }
+        _any_hung = !_hung.empty();
+        for(size_t i = 0; i < n; ++i) {
+            if (_hung.count(h->handles[i])) {
+                h->state[i].store(HARVEST_ABANDONED, std::memory_order_relaxed);
+                h->finished.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    worker_pool_t& pool = harvest_pool();
+    for(size_t i = 0, workers = std::min(pool.size(), n); i < workers; ++i) {
+        pool.submit([h] { harvest_windows(h); });
+    }
+    {
+        std::unique_lock<std::mutex> lock(h->mutex);
+        h->done.wait_until(lock, deadline, [&h, n] { return h->finished.load() == n; });
+    }
+
+    // previous values of slow windows, only looked up if there are any
+    rcu_cell_t<desktop_snapshot_t>::read_t prev(_snapshot);
+    std::unordered_map<hwnd_t, const window_info_t*> prev_windows;
+
+    // still running past the deadline: hung, skipped until it answers. the
+    // state is checked again after publishing _any_hung, either that or
+    // the worker's check sees the other side.
+    vector<size_t> running;
+    for(size_t i = 0; i < n; ++i) {
+        if (h->state[i].load() == HARVEST_RUNNING) {
+            running.push_back(i);
+        }
+    }
+    if (!running.empty()) {
+        std::lock_guard<std::mutex> lock(_hung_mutex);
+        for(size_t i: running) {
+            _hung.insert(h->handles[i]);
+        }
+        _any_hung = true;
+        for(size_t i: running) {
+            if (h->state[i].load() != HARVEST_RUNNING) {
+                _hung.erase(h->handles[i]);
+            }
+        }
+        _any_hung = !_hung.empty();
+    }
+
+    snap->windows.reserve(n);
+    for(size_t i = 0; i < n; ++i) {
+        int st = h->state[i].load(std::memory_order_acquire);
+        if (st == HARVEST_PENDING && h->state[i].compare_exchange_strong(st, HARVEST_ABANDONED)) {
+            st = HARVEST_ABANDONED;
+        }
+        if (st == HARVEST_DONE) {
+            snap->windows.push_back(std::move(h->results[i]));
+        } else if (st == HARVEST_RUNNING || st == HARVEST_ABANDONED) {
+            if (prev && prev_windows.empty()) {
+                for(const auto& w: prev->windows) {
+                    prev_windows[w.hwnd] = &w;
+                }
+            }
+            const auto it = prev_windows.find(h->handles[i]);
+            if (it != prev_windows.end()) {
+                snap->windows.push_back(*it->second);
+                ++snap->stale;
+            }
+        }
+    }
+
+    // the ones the configuration says to leave alone
+    rcu_cell_t<config_t>::read_t config(_config);
+    if (config && !config->ignore.empty()) {
+        const bool processes = config->ignores_processes();
+        std::unordered_map<uint32_t, wstring> names;
+        auto it = std::remove_if(snap->windows.begin(), snap->windows.end(), [&](const window_info_t& w) {
+            wstring_view process;
+            if (processes) {
+                auto n = names.find(w.pid);
+                if (n == names.end()) {
+                    n = names.emplace(w.pid, wstring()).first;
+                    _ws->process_name(w.pid, n->second);
+                }
+                process = n->second;
+            }
+            return config->ignored(w.cls, w.title, process);
+        });
+        snap->windows.erase(it, snap->windows.end());
+    }
+
+    for(const auto& w: snap->windows) {
+        if (snap->monitors.find(w.hmon) == snap->monitors.end()) {
+            // attached after the monitors were enumerated
+            snap->monitors[w.hmon] = get_monitor_info(w.hmon);
+        }
+    }
+
+    snap->generation = ++_snapshot_generation;
+    snap->duration_ms = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    return snap;
+}
+
+void publish_snapshot(unique_ptr<desktop_snapshot_t> snap)
+{
+    // by the order the scans started in: one that finished later but
+    // enumerated earlier would bring back windows closed meanwhile
+    _snapshot.publish_if(std::move(snap), [](const desktop_snapshot_t* current, const desktop_snapshot_t& s) {
+        return !current || current->scan < s.scan;
+    });
+}
+
+void scanner_t::start(std::function<void()> notify)
+{
+    _notify = notify;
+    _thread = std::thread(&scanner_t::run, this);
+}
+
+void scanner_t::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cv.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void scanner_t::request()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requested = true;
+    }
+    _cv.notify_one();
+}
+
+void scanner_t::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_quit) {
+        _requested = false;
+        lock.unlock();
+        publish_snapshot(build_snapshot());
+        _notify();
+        lock.lock();
+        _cv.wait_for(lock, std::chrono::milliseconds(SCAN_INTERVAL_MS), [this] {
+            return _quit || _requested;
+        });
+    }
+}
+
+void remember_focus()
+{
+    hwnd_t hwnd = _ws->foreground_window();
+    if (hwnd != _main_window) {
+        _focus_before = hwnd;
+    }
+}
+
+hwnd_t switched_focus()
+{
+    return _switched_focus;
+}
+
+// the window the user works with, not the frontend's
+static hwnd_t user_focus()
+{
+    hwnd_t focus = _ws->foreground_window();
+    return focus == _main_window ? _focus_before : focus;
+}
+
+// which of its windows had the focus and how they were stacked
+static void remember_stacking(container_t& c)
+{
+    hwnd_t focus = user_focus();
+    c.focus = c.wmap.find(focus) != c.wmap.end() ? focus : nullptr;
+
+    // windows are enumerated top to bottom
+    static vector<hwnd_t> all;
+    _ws->enum_windows(all);
+    c.zorder.clear();
+    for(hwnd_t hwnd: all) {
+        if (c.wmap.find(hwnd) != c.wmap.end()) {
+            c.zorder.push_back(hwnd);
+        }
+    }
+}
+
+static void restore_stacking(container_t& c)
+{
+    // windows might have been closed or moved elsewhere meanwhile
+    c.zorder.erase(std::remove_if(c.zorder.begin(), c.zorder.end(), [&c](hwnd_t hwnd) {
+        return c.wmap.find(hwnd) == c.wmap.end();
+    }), c.zorder.end());
+    if (c.wmap.find(c.focus) == c.wmap.end()) {
+        c.focus = c.zorder.empty() ? nullptr : c.zorder.front();
+    }
+    _switched_focus = c.focus;
+    if (c.zorder.empty()) {
+        return;
+    }
+    _ws->restack_windows(c.zorder, c.focus);
+}
+
+// hides `c` keeping the stacking it has, restore_layout() sets it itself
+static void hide_container(container_t& c)
+{
+    layout_change_t change;
+    for(auto& we : c.wmap) {
+        show_hide_window(we.second, false);
+    }
+    throttle_hidden_processes(c);
+}
+
+bool show_hide_container(shared_ptr<container_t> c, bool show)
+{
+    if (!c) {
+        return false;
+    }
+
+    if (!show) {
+        remember_stacking(*c);
+        hide_container(*c);
+        return true;
+    }
+    layout_change_t change;
+    restore_processes(*c);
+    for(auto& we : c->wmap) {
+        show_hide_window(we.second, true);
+    }
+    restore_stacking(*c);
+    return true;
+}
+
+bool reconcile_monitors(const topology_t& monitors)
+{
+    if (monitors.empty()) {
+        // failed enumeration rather than all displays unplugged
+        return false;
+    }
+    if (_topology.empty()) {
+        _topology = monitors;
+        return false;
+    }
+
+    bool changed = monitors.size() != _topology.size();
+    const vector<monitor_remap_t> remaps = match_monitors(_topology, monitors);
+    for(const auto& r: remaps) {
+        changed = changed || r.from != r.to || r.moved;
+    }
+    if (!changed) {
+        // dpi or work area changes only, relative geometry stays valid
+        _topology = monitors;
+        return false;
+    }
+
+    layout_change_t change;
+    // built anew in one pass, handles may have been swapped between monitors
+    monitor_map_t remapped;
+    for(const auto& r: remaps) {
+        const auto mit = _monitors.find(r.from);
+        shared_ptr<container_t> c = mit != _monitors.end() ? mit->second.lock() : shared_ptr<container_t>();
+
+        wstring txt(L"monitor ");
+        txt.append(_topology[r.from].device);
+        if (!r.to) {
+            txt.append(L" is gone");
+            log_debug(txt);
+            // nowhere to show its container anymore
+            show_hide_container(c, false);
+            continue;
+        }
+
+        const monitor_info_t& info = monitors.find(r.to)->second;
+        txt.append(L" is now ");
+        txt.append(info.device);
+        txt.append(L" ");
+        txt.append(_w(info.rect));
+        log_debug(txt);
+        if (!c) {
+            continue;
+        }
+        remapped[r.to] = c;
+        if (r.moved) {
+            // the window system only keeps windows on screen, rescale them
+            // from their relative geometry instead
+            place_container(*c, info.rect);
+        }
+    }
+    _monitors.swap(remapped);
+    _topology = monitors;
+    publish_status();
+    return true;
+}
+
+static topology_t enum_topology()
+{
+    topology_t monitors;
+    vector<hmonitor_t> handles;
+    _ws->enum_monitors(handles);
+    for(hmonitor_t hmon: handles) {
+        monitor_info_t info;
+        if (_ws->monitor_info(hmon, info)) {
+            monitors[hmon] = info;
+        }
+    }
+    return monitors;
+}
+
+void display_changed()
+{
+    traced_event_t event(TRACE_DISPLAY_CHANGE);
+    reconcile_monitors(enum_topology());
+    _scanner.request();
+}
+
+// drop interned strings no container or window refers to anymore
+void sweep_strings()
+{
+    for(const auto& c: _containers) {
+        _strings.mark(c.first);
+        for(const auto& w: c.second->wmap) {
+            _strings.mark(w.second.title);
+            _strings.mark(w.second.cls);
+        }
+    }
+    for(const auto& it: _class_hide_strategies) {
+        _strings.mark(it.first);
+    }
+    mark_history_strings();
+    _strings.sweep();
+}
+
+// scans only ever add windows, drops the destroyed ones from their
+// containers a batch at a time
+static idle_result_t prune_windows()
+{
+    size_t checked = 0;
+    for(auto cit = _containers.lower_bound(_prune_container); cit != _containers.end(); ++cit) {
+        container_t& c = *cit->second;
+        auto wit = cit->first == _prune_container ? c.wmap.lower_bound(_prune_window) : c.wmap.begin();
+        while (wit != c.wmap.end()) {
+            if (checked++ == PRUNE_BATCH) {
+                _prune_container = cit->first;
+                _prune_window = wit->first;
+                return IDLE_MORE;
+            }
+            const hwnd_t hwnd = wit->first;
+            if (_ws->is_window(hwnd)) {
+                ++wit;
+                continue;
+            }
+            wit = c.wmap.erase(wit);
+            c.zorder.erase(std::remove(c.zorder.begin(), c.zorder.end(), hwnd), c.zorder.end());
+            if (c.focus == hwnd) {
+                c.focus = nullptr;
+            }
+        }
+    }
+    _prune_container = NO_ATOM;
+    _prune_window = nullptr;
+    return IDLE_DONE;
+}
+
+// display changes whose notification got lost
+static idle_result_t reconcile_displays()
+{
+    if (reconcile_monitors(enum_topology())) {
+        _scanner.request();
+    }
+    return IDLE_DONE;
+}
+
+static void add_core_job(const wchar_t* name, int priority, unsigned interval_ms, unsigned slice_us,
+        idle_result_t (*step)())
+{
+    add_idle_job(name, priority, interval_ms, slice_us, [name, step] {
+        traced_event_t event(TRACE_IDLE, name);
+        return step();
+    });
+}
+
+static void add_core_jobs()
+{
+    add_core_job(L"reconcile", 0, 5000, 2000, reconcile_displays);
+    add_core_job(L"prune", 1, 10000, 1000, prune_windows);
+    add_core_job(L"sweep", 2, 30000, 2000, [] {
+        sweep_strings();
+        return IDLE_DONE;
+    });
+}
+
+// assigns the snapshot's windows to the containers shown on their monitors
+void apply_snapshot(const desktop_snapshot_t& snap)
+{
+    topology_t monitors;
+    for(const auto& it: snap.monitors) {
+        if (it.second.valid) {
+            monitors[it.first] = it.second.info;
+        }
+    }
+    if (reconcile_monitors(monitors)) {
+        // in case the notification got lost. the window rects were taken
+        // before the containers got rescaled, wait for the next scan
+        _applied_generation = snap.generation;
+        _applied_scan = snap.scan;
+        _scanner.request();
+        return;
+    }
+
+    // relative geometry, converted in one batch per monitor. GUI thread
+    // only, the buffers are reused.
+    static vector<drect_t> relative;
+    static vector<size_t> index;
+    static rect_array_t<int32_t> absolute;
+    static rect_array_t<double> converted;
+    relative.resize(snap.windows.size());
+    for(const auto& m: snap.monitors) {
+        if (!m.second.valid) {
+            continue;
+        }
+        index.clear();
+        absolute.clear();
+        for(size_t i = 0; i < snap.windows.size(); ++i) {
+            const rect_t& r = snap.windows[i].rect;
+            if (snap.windows[i].hmon == m.first) {
+                index.push_back(i);
+                absolute.push_back(r.left, r.top, r.right, r.bottom);
+            }
+        }
+        transform_rects(absolute, relative_to(m.second.info.rect), converted);
+        for(size_t j = 0; j < index.size(); ++j) {
+            relative[index[j]] = {converted.left[j], converted.top[j], converted.right[j], converted.bottom[j]};
+        }
+    }
+
+    bool created = false;
+    for(size_t i = 0; i < snap.windows.size(); ++i) {
+        const window_info_t& w = snap.windows[i];
+        const monitor_t& mon = snap.monitors.find(w.hmon)->second;
+        if (!mon.valid) {
+            continue;
+        }
+
+        shared_ptr<container_t> cont = _monitors[w.hmon].lock();
+        if (!cont) {
+            cont = new_container();
+            if (!cont) {
+                continue;
+            }
+            _monitors[w.hmon] = cont;
+            created = true;
+        }
+
+        window_t win = {w.hwnd, relative[i], _strings.intern(w.title),
+            _strings.intern(w.cls), w.pid, w.show, true, w.rect, HIDE_SHOW_WINDOW};
+        cont->wmap[w.hwnd] = win;
+        // on screen, its process can't stay throttled
+        restore_process(w.pid);
+    }
+    _applied_generation = snap.generation;
+    _applied_scan = snap.scan;
+    if (created) {
+        publish_status();
+    }
+}
+
+uint64_t snapshot_generation()
+{
+    return _snapshot_generation.load();
+}
+
+uint64_t scans_started()
+{
+    return _scans_started.load();
+}
+
+bool apply_latest_snapshot()
+{
+    traced_event_t event(TRACE_APPLY);
+    rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+    if (!snap || snap->generation == _applied_generation) {
+        return false;
+    }
+    if (snap->epoch != _layout_epoch.load()) {
+        // windows were shown or hidden while it was taken
+        return false;
+    }
+    apply_snapshot(*snap);
+    return true;
+}
+
+void scan_current_desktops()
+{
+    traced_event_t event(TRACE_SCAN);
+    publish_snapshot(build_snapshot());
+    apply_latest_snapshot();
+}
+
+bool move_to_monitor(shared_ptr<container_t> c, hmonitor_t hmon)
+{
+    if (!c || !hmon) {
+        return false;
+    }
+
+    layout_change_t change;
+
+    // drop container from another monitor where it's currently visible?
+    for(auto it = _monitors.cbegin(); it != _monitors.end();) {
+        shared_ptr<container_t> mc = it->second.lock();
+        if (c == mc) {
+            _monitors.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    monitor_t mon = get_monitor_info(hmon);
+
+    place_container(*c, mon.info.rect);
+
+    _monitors[hmon] = c;
+    return true;
+}
+
+bool move_to_current_monitor(shared_ptr<container_t> c)
+{
+    return move_to_monitor(c, current_monitor_handle());
+}
+
+bool switch_to_desktop(wstring_view name, bool scan)
+{
+    traced_event_t event(TRACE_SWITCH, name);
+    event.u(scan);
+    _layout_last = layout_stats_t();
+    _switched_focus = nullptr;
+    const auto start = std::chrono::steady_clock::now();
+    std::pmr::wstring msg(L"Switching to container ", _arena.resource());
+    msg.append(name);
+    log_debug(msg.c_str());
+    shared_ptr<container_t> current = current_container();
+    if (current && (_strings.find(name) == current->name)) {
+        log_debug(L"oh, we're already on the correct container");
+        return true;
+    }
+
+    shared_ptr<container_t> next = find_container(name);
+    if (!next) {
+        log_debug(L"container not found, creating a new one");
+        next = new_container(name);
+    }
+
+    if (!next) {
+        msg.assign(L"container not found: ").append(name);
+        log_debug(msg.c_str());
+        return false;
+    }
+
+    if (scan) {
+        scan_current_desktops();
+    }
+    remember_layout();
+    show_hide_container(current, false);
+    move_to_current_monitor(next);
+
+    if (current && current->wmap.empty()) {
+        delete_container(current);
+    }
+    show_hide_container(next, true);
+    publish_status();
+    remember_layout();
+    _last_switch_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    _scanner.request();
+    return true;
+}
+
+// makes `v` the layout in one commit. windows closed since are dropped,
+// windows opened since stay in their container, or get shown for the next
+// scan to adopt them if the version doesn't have it.
+static void restore_layout(const layout_version_t& v)
+{
+    const auto start = std::chrono::steady_clock::now();
+    layout_change_t change;
+
+    std::set<atom_t> names;
+    std::set<atom_t> shown;
+    std::set<hwnd_t> restored;
+    map<hwnd_t, window_t> live;
+    for(const auto& c: _containers) {
+        for(const auto& w: c.second->wmap) {
+            live.emplace(w.first, w.second);
+        }
+    }
+    for(const auto& r: v.containers) {
+        names.insert(r->name);
+        for(const auto& w: r->wmap) {
+            if (live.find(w.first) != live.end()) {
+                restored.insert(w.first);
+            }
+        }
+    }
+    for(const auto& m: v.monitors) {
+        shown.insert(m.second);
+    }
+
+    for(auto it = _containers.begin(); it != _containers.end();) {
+        if (names.find(it->first) != names.end()) {
+            ++it;
+            continue;
+        }
+        for(auto& w: it->second->wmap) {
+            if (restored.find(w.first) == restored.end()) {
+                show_hide_window(w.second, true);
+            }
+        }
+        it = _containers.erase(it);
+    }
+
+    for(const auto& r: v.containers) {
+        shared_ptr<container_t>& c = _containers[r->name];
+        if (!c) {
+            c = make_shared<container_t>(r->name);
+        }
+        window_map_t wmap;
+        for(const auto& w: r->wmap) {
+            auto l = live.find(w.first);
+            if (l == live.end()) {
+                continue;
+            }
+            // the geometry as it was, everything else as it is now
+            window_t win = l->second;
+            win.rect = w.second.rect;
+            win.show = w.second.show;
+            wmap.emplace(w.first, win);
+        }
+        for(const auto& w: c->wmap) {
+            if (restored.find(w.first) == restored.end()) {
+                wmap.insert(w);
+            }
+        }
+        c->wmap.swap(wmap);
+        c->focus = r->focus;
+        c->zorder = r->zorder;
+    }
+
+    // the focus and stacking of the version, not what's on screen
+    for(const auto& c: _containers) {
+        if (shown.find(c.first) == shown.end()) {
+            hide_container(*c.second);
+        }
+    }
+    _monitors.clear();
+    for(const auto& m: v.monitors) {
+        if (!_topology.empty() && _topology.find(m.first) == _topology.end()) {
+            // unplugged since, it stays hidden
+            continue;
+        }
+        shared_ptr<container_t> c = _containers[m.second];
+        move_to_monitor(c, m.first);
+        show_hide_container(c, true);
+    }
+    publish_status();
+
+    ++_history_stats.restored;
+    _history_stats.last_restore_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool undo_layout()
+{
+    traced_event_t event(TRACE_UNDO);
+    if (history_size() && history_position() + 1 == history_size()) {
+        // so redo gets back to what's there now
+        remember_layout();
+    }
+    shared_ptr<const layout_version_t> v = step_history(1);
+    if (!v) {
+        log_debug(L"nothing to undo");
+        return false;
+    }
+    restore_layout(*v);
+    return true;
+}
+
+bool redo_layout()
+{
+    traced_event_t event(TRACE_REDO);
+    shared_ptr<const layout_version_t> v = step_history(-1);
+    if (!v) {
+        log_debug(L"nothing to redo");
+        return false;
+    }
+    restore_layout(*v);
+    return true;
+}
+
+void containers_by_name(vector<const container_map_t::value_type*>& out)
+{
+    out.clear();
+    for(const auto& e: _containers) {
+        out.push_back(&e);
+    }
+    std::sort(out.begin(), out.end(), [](const container_map_t::value_type* a, const container_map_t::value_type* b) {
+        return _strings.str(a->first) < _strings.str(b->first);
+    });
+}
+
+void preview_containers(wstring_view query)
+{
+    traced_event_t event(TRACE_PREVIEW, query);
+    clear_preview();
+
+    // matching is case insensitive against the pooled lowercase forms, the
+    // buffers are kept around to avoid reallocating them on every keystroke
+    static wstring needle;
+    static wstring line;
+    static vector<const container_map_t::value_type*> sorted;
+    string_pool_t::to_lower(query, needle);
+    containers_by_name(sorted);
+    for(const auto* e: sorted) {
+        const wstring& name = _strings.str(e->first);
+        if (_strings.lower(e->first).find(needle) != wstring::npos) {
+            log_info(name);
+        } else {
+            for(const auto& w: e->second->wmap) {
+                atom_t t = w.second.title;
+                if (_strings.lower(t).find(needle) != wstring::npos) {
+                    line.assign(name).append(L" - ").append(_strings.str(t));
+                    log_info(line);
+                }
+            }
+        }
+    }
+}
+
+size_t move_windows(window_match_t match, wstring_view pattern, wstring_view target)
+{
+    traced_event_t event(TRACE_MOVE, target);
+    event.u(match);
+    event.str(pattern);
+    if (target.empty() || (match != MATCH_FOCUS && pattern.empty())) {
+        return 0;
+    }
+
+    const hwnd_t focus = match == MATCH_FOCUS ? user_focus() : nullptr;
+    wstring needle;
+    string_pool_t::to_lower(pattern, needle);
+    // lowercase process names, looked up once per process
+    std::unordered_map<uint32_t, wstring> processes;
+    auto matches = [&](const window_t& w) {
+        switch (match) {
+            case MATCH_FOCUS:
+                return w.hwnd == focus;
+            case MATCH_TITLE:
+                return _strings.lower(w.title).find(needle) != wstring::npos;
+            case MATCH_CLASS:
+                return _strings.lower(w.cls).find(needle) != wstring::npos;
+            case MATCH_PROCESS:
+                {
+                    auto it = processes.find(w.pid);
+                    if (it == processes.end()) {
+                        wstring name;
+                        _ws->process_name(w.pid, name);
+                        it = processes.emplace(w.pid, wstring()).first;
+                        string_pool_t::to_lower(name, it->second);
+                    }
+                    return it->second.find(needle) != wstring::npos;
+                }
+        }
+        return false;
+    };
+
+    shared_ptr<container_t> dest = find_container(target);
+    vector<std::pair<shared_ptr<container_t>, hwnd_t>> picked;
+    for(const auto& c: _containers) {
+        if (c.second == dest) {
+            continue;
+        }
+        for(const auto& w: c.second->wmap) {
+            if (matches(w.second)) {
+                picked.emplace_back(c.second, w.first);
+            }
+        }
+    }
+    if (picked.empty()) {
+        log_debug(L"no windows to move");
+        return 0;
+    }
+
+    _layout_last = layout_stats_t();
+    remember_layout();
+    if (!dest) {
+        dest = new_container(target);
+    }
+    hmonitor_t hmon = nullptr;
+    for(const auto& m: _monitors) {
+        if (m.second.lock() == dest) {
+            hmon = m.first;
+        }
+    }
+
+    layout_change_t change;
+    // the nodes move over as they are, pointers to the windows stay valid
+    static vector<window_t*> moved;
+    moved.clear();
+    std::set<shared_ptr<container_t>> sources;
+    for(const auto& p: picked) {
+        container_t& from = *p.first;
+        auto node = from.wmap.extract(p.second);
+        window_t& w = dest->wmap.insert(std::move(node)).position->second;
+        from.zorder.erase(std::remove(from.zorder.begin(), from.zorder.end(), p.second), from.zorder.end());
+        if (from.focus == p.second) {
+            from.focus = nullptr;
+        }
+        sources.insert(p.first);
+        moved.push_back(&w);
+    }
+
+    if (hmon) {
+        // relative geometry carries over, placed on the target's monitor
+        // in one transform
+        static rect_array_t<double> relative;
+        static rect_array_t<int32_t> absolute;
+        relative.clear();
+        for(const window_t* w: moved) {
+            relative.push_back(w->rect.left, w->rect.top, w->rect.right, w->rect.bottom);
+        }
+        transform_rects(relative, absolute_on(get_monitor_info(hmon).info.rect), absolute);
+        restore_processes(*dest);
+        for(size_t i = 0; i < moved.size(); ++i) {
+            place_window(*moved[i], {absolute.left[i], absolute.top[i], absolute.right[i], absolute.bottom[i]});
+            show_hide_window(*moved[i], true);
+        }
+    } else {
+        for(window_t* w: moved) {
+            show_hide_window(*w, false);
+            // stacked below its windows once shown
+            dest->zorder.push_back(w->hwnd);
+        }
+        throttle_hidden_processes(*dest);
+    }
+
+    for(const auto& c: sources) {
+        if (!c->wmap.empty()) {
+            continue;
+        }
+        const bool on_monitor = std::any_of(_monitors.begin(), _monitors.end(), [&c](const monitor_map_t::value_type& m) {
+            return m.second.lock() == c;
+        });
+        if (!on_monitor) {
+            delete_container(c);
+        }
+    }
+    publish_status();
+    remember_layout();
+    _scanner.request();
+
+    std::pmr::wstring msg(L"moved ", _arena.resource());
+    msg.append(_w(moved.size())).append(L" windows to ").append(target);
+    log_debug(msg.c_str());
+    return moved.size();
+}
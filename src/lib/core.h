@@ -0,0 +1,287 @@
+#ifndef _LIBTTWWAM_CORE_H_
+#define _LIBTTWWAM_CORE_H_
+
+// containers, monitors and the snapshots they're built from. nothing in here
+// talks to win32 directly, all window system calls go through winsys_t so
+// the same code runs in the GUI and in the trace replay.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "intern.h"
+#include "rcu.h"
+#include "topology.h"
+#include "winsys.h"
+
+class trace_writer_t;
+class worker_pool_t;
+
+const wchar_t* const NL = L"\r\n";
+
+// implemented by the frontend (the GUI writes to its EDIT controls)
+void log_debug(const wchar_t* txt);
+void log_info(const wchar_t* txt);
+void clear_preview();
+
+inline void log_debug(const std::wstring& txt)
+{
+    log_debug(txt.c_str());
+}
+
+inline void log_info(const std::wstring& txt)
+{
+    log_info(txt.c_str());
+}
+
+template<typename T>
+std::wstring _w(T in)
+{
+    std::wstringstream ss;
+    ss << in;
+    return ss.str();
+}
+
+struct drect_t {
+    double left;
+    double top;
+    double right;
+    double bottom;
+};
+
+template<>
+std::wstring _w<rect_t>(rect_t r);
+template<>
+std::wstring _w<drect_t>(drect_t r);
+
+// quick declaration ... implementation follows
+struct window_t {
+    hwnd_t hwnd;
+    drect_t rect;
+    atom_t title;
+    atom_t cls;
+    uint32_t pid;
+    window_show_t show;
+    // last state we set or observed, window system calls that wouldn't
+    // change it are skipped
+    bool shown;
+    rect_t placed;
+    // how it was hidden, it's shown again the same way
+    hide_strategy_t hidden_by;
+    std::wstring tostr() const;
+};
+
+struct monitor_t {
+    hmonitor_t hmon;
+    bool valid;
+    monitor_info_t info;
+
+    rect_t get_absolute_window_rect(const window_t& window) const;
+    std::wstring tostr() const;
+};
+
+typedef std::map<hwnd_t, window_t> window_map_t;
+
+struct container_t {
+    atom_t name;
+    // weak_ptr<monitor_t> mon;
+    window_map_t wmap;
+    // recorded when hidden, restored when shown again
+    hwnd_t focus = nullptr;
+    std::vector<hwnd_t> zorder;
+
+    container_t(atom_t name)
+        : name(name)
+    {}
+
+    std::wstring tostr() const;
+};
+
+typedef std::map<atom_t, std::shared_ptr<container_t>> container_map_t;
+
+// window system calls made and saved by committing layouts
+struct layout_stats_t {
+    size_t shown = 0;
+    size_t hidden = 0;
+    size_t moved = 0;
+    size_t skipped = 0;
+};
+typedef std::map<hmonitor_t, std::weak_ptr<container_t>> monitor_map_t;
+
+// what the window system looked like at some point in time. snapshots are
+// built off the GUI thread and never modified once published.
+struct window_info_t {
+    hwnd_t hwnd;
+    hmonitor_t hmon;
+    rect_t rect;
+    window_show_t show;
+    std::wstring title;
+    std::wstring cls;
+    uint32_t pid;
+};
+
+struct desktop_snapshot_t {
+    // in the order the builds finished
+    uint64_t generation;
+    // in the order they started, see scans_started()
+    uint64_t scan;
+    // _layout_epoch when the scan started
+    uint64_t epoch;
+    std::map<hmonitor_t, monitor_t> monitors;
+    std::vector<window_info_t> windows;
+    // windows that missed the harvest deadline and were copied from the
+    // previous snapshot
+    size_t stale;
+    unsigned duration_ms;
+};
+
+// scans in the background and publishes the results, `notify` is called
+// (on the scanner thread) after each one
+class scanner_t {
+public:
+    void start(std::function<void()> notify);
+    void stop();
+    void request();
+
+private:
+    void run();
+
+    std::function<void()> _notify;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _requested = false;
+    bool _quit = false;
+};
+
+// all container names and window titles live here
+extern string_pool_t _strings;
+// scratch memory of the UI event (keystroke, command) being handled
+extern event_arena_t _arena;
+
+// ordered by atom, which is arbitrary and changes as atoms get recycled
+extern container_map_t _containers;
+extern monitor_map_t _monitors;
+// the monitors containers were last placed on
+extern topology_t _topology;
+
+extern layout_stats_t _layout_total;
+// since the start of the last switch
+extern layout_stats_t _layout_last;
+
+// time spent hiding and showing windows, per strategy
+struct hide_stats_t {
+    size_t calls = 0;
+    double total_us = 0;
+    double max_us = 0;
+};
+extern hide_stats_t _hide_stats[HIDE_STRATEGIES];
+extern double _last_switch_us;
+
+extern rcu_cell_t<desktop_snapshot_t> _snapshot;
+extern uint64_t _applied_generation;
+// scan of the last snapshot applied
+extern uint64_t _applied_scan;
+extern scanner_t _scanner;
+
+// `main_window` is never treated as a managed window. also registers the
+// housekeeping jobs (monitor reconciliation, pruning closed windows and
+// sweeping strings) with the idle scheduler, see idle.h.
+void core_init(winsys_t* ws, hwnd_t main_window);
+// forget all state, for running a trace replay more than once
+void core_reset();
+// record events into `trace` (or stop recording, if null)
+void core_trace(trace_writer_t* trace);
+void trace_input(std::wstring_view what);
+
+winsys_t& winsys();
+worker_pool_t& harvest_pool();
+// windows skipped by scans since they hung one, until they answer again
+size_t hung_windows();
+
+monitor_t get_monitor_info(hmonitor_t hmon);
+hmonitor_t current_monitor_handle();
+monitor_t current_monitor();
+
+// _containers sorted by name, for listing them to the user or other
+// programs. reuses the capacity of `out`.
+void containers_by_name(std::vector<const container_map_t::value_type*>& out);
+std::shared_ptr<container_t> current_container();
+std::shared_ptr<container_t> find_container(std::wstring_view name);
+std::shared_ptr<container_t> new_container(std::wstring_view name=L"");
+bool delete_container(std::shared_ptr<container_t> c);
+
+const wchar_t* hide_strategy_name(hide_strategy_t strategy);
+// for windows of class `cls`, or all others if empty. hiding is the default,
+// cloaking falls back to it for classes the window system refuses to cloak
+// (with DWM that's any window of another process).
+void set_hide_strategy(std::wstring_view cls, hide_strategy_t strategy);
+hide_strategy_t hide_strategy(atom_t cls);
+void show_hide_window(window_t& window, bool show);
+void place_window(window_t& window, const rect_t& r);
+bool show_hide_container(std::shared_ptr<container_t> c, bool show);
+bool move_to_monitor(std::shared_ptr<container_t> c, hmonitor_t hmon);
+bool move_to_current_monitor(std::shared_ptr<container_t> c);
+
+// the window that had the focus before the frontend took it, called when
+// the frontend's window gets shown
+void remember_focus();
+// the window focused by the last switch, or null
+hwnd_t switched_focus();
+
+// reassigns containers after the display configuration changed, returns
+// whether anything did
+bool reconcile_monitors(const topology_t& monitors);
+// re-enumerates the monitors and reconciles, on display change notifications
+void display_changed();
+
+// safe to call from any thread
+std::unique_ptr<desktop_snapshot_t> build_snapshot();
+// publishes `snap` unless one of a scan that started later is published
+// already, the GUI thread and the scanner build them concurrently
+void publish_snapshot(std::unique_ptr<desktop_snapshot_t> snap);
+// of the last snapshot built
+uint64_t snapshot_generation();
+// builds started so far, on any thread. a snapshot with a higher scan
+// enumerated the windows after the call.
+uint64_t scans_started();
+bool apply_latest_snapshot();
+// synchronous scan, for commands that must see the current state
+void scan_current_desktops();
+
+// without `scan` the layout is committed against the latest applied
+// snapshot, for callers that just waited for a fresh one
+bool switch_to_desktop(std::wstring_view name, bool scan = true);
+// restore the layout before the last switch or container command, or the
+// one undone last. false if there's none.
+bool undo_layout();
+bool redo_layout();
+// lists the containers and windows matching `query` in the preview
+void preview_containers(std::wstring_view query);
+
+// how move_windows() picks windows
+enum window_match_t : uint8_t {
+    MATCH_FOCUS,
+    MATCH_TITLE,
+    MATCH_CLASS,
+    MATCH_PROCESS,
+};
+
+// moves the focused window, or the windows whose title, class or process
+// name contains `pattern` (ignoring case), to container `target`, which is
+// created if needed. all of them are committed at once against the current
+// state: a single layout change, no rescans, and the windows are placed on
+// the target's monitor in one batch. returns how many moved.
+size_t move_windows(window_match_t match, std::wstring_view pattern, std::wstring_view target);
+
+#endif // _LIBTTWWAM_CORE_H_
@@ -0,0 +1,403 @@
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "core.h"
+#include "export.h"
+
+using std::shared_ptr;
+using std::string_view;
+using std::wstring_view;
+
+static const char EXPORT_MAGIC[4] = {'T', 'T', 'W', 'S'};
+static const size_t EXPORT_FLUSH_SIZE = 64 * 1024;
+
+export_writer_t::export_writer_t(export_format_t format, FILE* f)
+    : _format(format), _f(f)
+{
+    _buffer.reserve(EXPORT_FLUSH_SIZE + 4096);
+    if (_format == EXPORT_BINARY) {
+        _buffer.append(EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+        _buffer.push_back(static_cast<char>(EXPORT_VERSION));
+    }
+}
+
+export_writer_t::~export_writer_t()
+{
+    flush();
+}
+
+void export_writer_t::flush()
+{
+    if (!_f || _buffer.empty()) {
+        return;
+    }
+    std::fwrite(_buffer.data(), 1, _buffer.size(), _f);
+    _flushed += _buffer.size();
+    _buffer.clear();
+}
+
+void export_writer_t::next_value()
+{
+    if (_format == EXPORT_JSON) {
+        if (_after_key) {
+            _after_key = false;
+        } else if (!_nonempty.empty()) {
+            if (_nonempty.back()) {
+                _buffer.push_back(',');
+            }
+            _nonempty.back() = true;
+        }
+    }
+    if (_f && _buffer.size() >= EXPORT_FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void export_writer_t::put_uvar(uint64_t v)
+{
+    while (v >= 0x80) {
+        _buffer.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    _buffer.push_back(static_cast<char>(v));
+}
+
+void export_writer_t::put_utf8(wstring_view v)
+{
+    // mostly ASCII, which is copied without going through the encoder
+    size_t ascii = 0;
+    while (ascii < v.size() && static_cast<uint32_t>(v[ascii]) < 0x80) {
+        ++ascii;
+    }
+    const size_t at = _buffer.size();
+    _buffer.resize(at + ascii);
+    for(size_t i = 0; i < ascii; ++i) {
+        _buffer[at + i] = static_cast<char>(v[i]);
+    }
+
+    for(size_t i = ascii; i < v.size(); ++i) {
+        uint32_t cp = static_cast<uint32_t>(v[i]);
+        if (sizeof(wchar_t) == 2 && cp >= 0xd800 && cp < 0xdc00 && i + 1 < v.size()) {
+            uint32_t lo = static_cast<uint32_t>(v[i + 1]);
+            if (lo >= 0xdc00 && lo < 0xe000) {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                ++i;
+            }
+        }
+        if (cp < 0x80) {
+            _buffer.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            _buffer.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else if (cp < 0x10000) {
+            _buffer.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else {
+            _buffer.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+    }
+}
+
+void export_writer_t::put_json_string(wstring_view v)
+{
+    static const char hex[] = "0123456789abcdef";
+    _buffer.push_back('"');
+    size_t start = 0;
+    for(size_t i = 0; i < v.size(); ++i) {
+        wchar_t ch = v[i];
+        const uint32_t cp = static_cast<uint32_t>(ch);
+        if (cp >= 0xd800 && cp < 0xe000) {
+            // a pair is encoded as is, a lone half has no UTF-8 form
+            if (sizeof(wchar_t) == 2 && cp < 0xdc00 && i + 1 < v.size()
+                    && static_cast<uint32_t>(v[i + 1]) >= 0xdc00 && static_cast<uint32_t>(v[i + 1]) < 0xe000) {
+                ++i;
+                continue;
+            }
+            put_utf8(v.substr(start, i - start));
+            start = i + 1;
+            _buffer.append("\\u");
+            for(int shift = 12; shift >= 0; shift -= 4) {
+                _buffer.push_back(hex[(cp >> shift) & 0xf]);
+            }
+            continue;
+        }
+        if (ch >= 0x20 && ch != L'"' && ch != L'\\') {
+            continue;
+        }
+        put_utf8(v.substr(start, i - start));
+        start = i + 1;
+        _buffer.push_back('\\');
+        switch (ch) {
+            case L'"': _buffer.push_back('"'); break;
+            case L'\\': _buffer.push_back('\\'); break;
+            case L'\n': _buffer.push_back('n'); break;
+            case L'\r': _buffer.push_back('r'); break;
+            case L'\t': _buffer.push_back('t'); break;
+            default:
+                _buffer.append("u00");
+                _buffer.push_back(hex[(ch >> 4) & 0xf]);
+                _buffer.push_back(hex[ch & 0xf]);
+        }
+    }
+    put_utf8(v.substr(start));
+    _buffer.push_back('"');
+}
+
+export_writer_t& export_writer_t::begin_object()
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        _buffer.push_back('{');
+        _nonempty.push_back(false);
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_BEGIN_OBJECT));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::end_object()
+{
+    if (_format == EXPORT_JSON) {
+        _buffer.push_back('}');
+        _nonempty.pop_back();
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_END_OBJECT));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::begin_array()
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        _buffer.push_back('[');
+        _nonempty.push_back(false);
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_BEGIN_ARRAY));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::end_array()
+{
+    if (_format == EXPORT_JSON) {
+        _buffer.push_back(']');
+        _nonempty.pop_back();
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_END_ARRAY));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::key(string_view k)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        // keys are ours, no escaping needed
+        _buffer.push_back('"');
+        _buffer.append(k);
+        _buffer.append("\":");
+        _after_key = true;
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_KEY));
+        put_uvar(k.size());
+        _buffer.append(k);
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::u(uint64_t v)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        char buf[24];
+        _buffer.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_UNSIGNED));
+        put_uvar(v);
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::s(int64_t v)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        char buf[24];
+        _buffer.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_SIGNED));
+        put_uvar((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::d(double v)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        if (!std::isfinite(v)) {
+            _buffer.append("null");
+        } else {
+            char buf[32];
+            _buffer.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+        }
+    } else {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_DOUBLE));
+        for(int i = 0; i < 8; ++i) {
+            _buffer.push_back(static_cast<char>(bits >> (8 * i)));
+        }
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::b(bool v)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        _buffer.append(v ? "true" : "false");
+    } else {
+        _buffer.push_back(static_cast<char>(v ? EXPORT_TAG_TRUE : EXPORT_TAG_FALSE));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::str(wstring_view v)
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        put_json_string(v);
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_STRING));
+        // room for the length of the longest possible encoding, patched
+        // once the actual one is known
+        const uint64_t longest = v.size() * (sizeof(wchar_t) == 2 ? 3 : 4);
+        size_t width = 1;
+        for(uint64_t x = longest; x >= 0x80; x >>= 7) {
+            ++width;
+        }
+        const size_t at = _buffer.size();
+        _buffer.resize(at + width);
+        put_utf8(v);
+        uint64_t n = _buffer.size() - at - width;
+        for(size_t i = 0; i < width; ++i, n >>= 7) {
+            _buffer[at + i] = static_cast<char>((n & 0x7f) | (i + 1 < width ? 0x80 : 0));
+        }
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::null()
+{
+    next_value();
+    if (_format == EXPORT_JSON) {
+        _buffer.append("null");
+    } else {
+        _buffer.push_back(static_cast<char>(EXPORT_TAG_NULL));
+    }
+    return *this;
+}
+
+export_writer_t& export_writer_t::rect(const rect_t& r)
+{
+    return begin_array().s(r.left).s(r.top).s(r.right).s(r.bottom).end_array();
+}
+
+static const wchar_t* show_state_name(window_show_t show)
+{
+    switch (show) {
+        case WINDOW_MINIMIZED: return L"minimized";
+        case WINDOW_MAXIMIZED: return L"maximized";
+        default: return L"normal";
+    }
+}
+
+static void export_window(export_writer_t& out, const window_t& w)
+{
+    out.begin_object();
+    out.key("hwnd").handle(w.hwnd);
+    out.key("title").str(_strings.str(w.title));
+    out.key("class").str(_strings.str(w.cls));
+    out.key("rect").begin_array().d(w.rect.left).d(w.rect.top).d(w.rect.right).d(w.rect.bottom).end_array();
+    out.key("placed").rect(w.placed);
+    out.key("shown").b(w.shown);
+    out.key("hidden_by").str(hide_strategy_name(w.hidden_by));
+    out.key("state").str(show_state_name(w.show));
+    out.end_object();
+}
+
+void export_state(export_writer_t& out, const export_filter_t& filter)
+{
+    out.begin_object();
+    out.key("generation").u(_applied_generation);
+
+    out.key("monitors").begin_array();
+    for(const auto& it: _topology) {
+        if (filter.monitor && it.first != filter.monitor) {
+            continue;
+        }
+        const monitor_info_t& info = it.second;
+        out.begin_object();
+        out.key("hmonitor").handle(it.first);
+        out.key("device").str(info.device);
+        out.key("path").str(info.path);
+        out.key("rect").rect(info.rect);
+        out.key("work").rect(info.work);
+        out.key("dpi").u(info.dpi);
+        out.key("container");
+        const auto mit = _monitors.find(it.first);
+        shared_ptr<container_t> c = mit != _monitors.end() ? mit->second.lock() : shared_ptr<container_t>();
+        if (c) {
+            out.str(_strings.str(c->name));
+        } else {
+            out.null();
+        }
+        out.end_object();
+    }
+    out.end_array();
+
+    out.key("containers").begin_array();
+    static std::vector<const container_map_t::value_type*> sorted;
+    containers_by_name(sorted);
+    for(const auto* e: sorted) {
+        const auto& it = *e;
+        if (filter.container && it.first != filter.container) {
+            continue;
+        }
+        hmonitor_t shown_on = nullptr;
+        for(const auto& m: _monitors) {
+            if (m.second.lock() == it.second) {
+                shown_on = m.first;
+                break;
+            }
+        }
+        if (filter.monitor && shown_on != filter.monitor) {
+            continue;
+        }
+        out.begin_object();
+        out.key("name").str(_strings.str(it.first));
+        out.key("hmonitor");
+        if (shown_on) {
+            out.handle(shown_on);
+        } else {
+            out.null();
+        }
+        out.key("windows").begin_array();
+        for(const auto& w: it.second->wmap) {
+            export_window(out, w.second);
+        }
+        out.end_array();
+        out.end_object();
+    }
+    out.end_array();
+
+    out.end_object();
+    out.flush();
+}
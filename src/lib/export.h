@@ -0,0 +1,104 @@
+#ifndef _LIBTTWWAM_EXPORT_H_
+#define _LIBTTWWAM_EXPORT_H_
+
+// structured state export, for monitoring
+//
+// values are streamed into a buffer that's handed to the file (if any)
+// whenever it fills up, nothing is formatted into intermediate strings.
+// the binary form is "TTWS", format version (1 byte), then tagged values:
+// EXPORT_TAG_* followed by LEB128 unsigned / zigzag signed integers, 8 byte
+// little endian doubles or length prefixed UTF-8 strings. string lengths
+// are padded with zero groups (5 as 0x85 0x00) to the width the longest
+// encoding of the string would need, so they're written before the string
+// is. JSON has lone UTF-16 surrogates as \uXXXX escapes.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "intern.h"
+#include "winsys.h"
+
+const uint8_t EXPORT_VERSION = 1;
+
+enum export_format_t {
+    EXPORT_JSON,
+    EXPORT_BINARY,
+};
+
+enum export_tag_t : uint8_t {
+    EXPORT_TAG_BEGIN_OBJECT = 1,
+    EXPORT_TAG_END_OBJECT,
+    EXPORT_TAG_BEGIN_ARRAY,
+    EXPORT_TAG_END_ARRAY,
+    EXPORT_TAG_KEY,
+    EXPORT_TAG_UNSIGNED,
+    EXPORT_TAG_SIGNED,
+    EXPORT_TAG_DOUBLE,
+    EXPORT_TAG_STRING,
+    EXPORT_TAG_FALSE,
+    EXPORT_TAG_TRUE,
+    EXPORT_TAG_NULL,
+};
+
+class export_writer_t {
+public:
+    // without a file everything stays in buffer()
+    explicit export_writer_t(export_format_t format, FILE* f = nullptr);
+    ~export_writer_t();
+
+    export_writer_t(const export_writer_t&) = delete;
+    export_writer_t& operator=(const export_writer_t&) = delete;
+
+    export_writer_t& begin_object();
+    export_writer_t& end_object();
+    export_writer_t& begin_array();
+    export_writer_t& end_array();
+    export_writer_t& key(std::string_view k);
+
+    export_writer_t& u(uint64_t v);
+    export_writer_t& s(int64_t v);
+    export_writer_t& d(double v);
+    export_writer_t& b(bool v);
+    export_writer_t& str(std::wstring_view v);
+    export_writer_t& null();
+    export_writer_t& handle(const void* h)
+    {
+        return u(reinterpret_cast<uintptr_t>(h));
+    }
+    export_writer_t& rect(const rect_t& r);
+
+    void flush();
+    const std::string& buffer() const { return _buffer; }
+    // including what was flushed already
+    size_t size() const { return _flushed + _buffer.size(); }
+
+private:
+    // JSON separators
+    void next_value();
+    void put_uvar(uint64_t v);
+    void put_utf8(std::wstring_view v);
+    void put_json_string(std::wstring_view v);
+
+    export_format_t _format;
+    FILE* _f;
+    std::string _buffer;
+    size_t _flushed = 0;
+    // per open object/array, whether a value was written to it yet
+    std::vector<bool> _nonempty;
+    bool _after_key = false;
+};
+
+// what to export, everything by default
+struct export_filter_t {
+    atom_t container = NO_ATOM;
+    hmonitor_t monitor = nullptr;
+};
+
+// monitors, containers and their windows as last committed, doesn't call
+// into the window system. containers are in name order. GUI thread only.
+void export_state(export_writer_t& out, const export_filter_t& filter);
+
+#endif // _LIBTTWWAM_EXPORT_H_
@@ -0,0 +1,159 @@
+#ifndef _LIBTTWWAM_GEOMETRY_H_
+#define _LIBTTWWAM_GEOMETRY_H_
+
+// converts whole containers' worth of window rects between absolute
+// coordinates and coordinates relative to a monitor in one pass.
+//
+// both directions are the same affine transform per coordinate,
+// out = in * scale + offset, applied to structure of arrays buffers so the
+// columns can be processed with SIMD. integer results are rounded to
+// nearest (ties to even, like the SSE2 conversion) and all coordinates are
+// signed, monitors left of or above the primary one have negative origins.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TTWWAM_SSE2 1
+#endif
+
+#include "winsys.h"
+
+template<typename T>
+struct rect_array_t {
+    static_assert(std::is_same<T, int32_t>::value || std::is_same<T, double>::value,
+            "rects are either int32_t (absolute) or double (relative)");
+
+    std::vector<T> left;
+    std::vector<T> top;
+    std::vector<T> right;
+    std::vector<T> bottom;
+
+    size_t size() const { return left.size(); }
+
+    void resize(size_t n)
+    {
+        left.resize(n);
+        top.resize(n);
+        right.resize(n);
+        bottom.resize(n);
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+    void push_back(T l, T t, T r, T b)
+    {
+        left.push_back(l);
+        top.push_back(t);
+        right.push_back(r);
+        bottom.push_back(b);
+    }
+};
+
+// scale and offset for both axes
+struct rect_transform_t {
+    double sx;
+    double ox;
+    double sy;
+    double oy;
+};
+
+// absolute -> fractions of the monitor rect
+inline rect_transform_t relative_to(const rect_t& monitor)
+{
+    const double w = static_cast<double>(monitor.right) - monitor.left;
+    const double h = static_cast<double>(monitor.bottom) - monitor.top;
+    return {1.0 / w, -monitor.left / w, 1.0 / h, -monitor.top / h};
+}
+
+// fractions of the monitor rect -> absolute
+inline rect_transform_t absolute_on(const rect_t& monitor)
+{
+    const double w = static_cast<double>(monitor.right) - monitor.left;
+    const double h = static_cast<double>(monitor.bottom) - monitor.top;
+    return {w, static_cast<double>(monitor.left), h, static_cast<double>(monitor.top)};
+}
+
+template<typename Out>
+inline Out convert_coordinate(double v)
+{
+    if constexpr (std::is_integral<Out>::value) {
+        return static_cast<Out>(std::nearbyint(v));
+    } else {
+        return v;
+    }
+}
+
+// one column, the scalar reference
+template<typename In, typename Out>
+void transform_column_scalar(const In* in, size_t n, double scale, double offset, Out* out)
+{
+    for(size_t i = 0; i < n; ++i) {
+        out[i] = convert_coordinate<Out>(static_cast<double>(in[i]) * scale + offset);
+    }
+}
+
+// one column, vectorized where there's a kernel for the combination of
+// types, the remainder is done by the scalar version
+template<typename In, typename Out>
+void transform_column(const In* in, size_t n, double scale, double offset, Out* out)
+{
+    size_t i = 0;
+#ifdef TTWWAM_SSE2
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+    if constexpr (std::is_same<In, int32_t>::value && std::is_same<Out, double>::value) {
+        for(; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128d lo = _mm_cvtepi32_pd(v);
+            __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(lo, s), o));
+            _mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_mul_pd(hi, s), o));
+        }
+    } else if constexpr (std::is_same<In, double>::value && std::is_same<Out, int32_t>::value) {
+        for(; i + 4 <= n; i += 4) {
+            __m128d lo = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i), s), o);
+            __m128d hi = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i + 2), s), o);
+            // rounds to nearest, ties to even
+            __m128i v = _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+    } else if constexpr (std::is_same<In, double>::value && std::is_same<Out, double>::value) {
+        for(; i + 2 <= n; i += 2) {
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i), s), o));
+        }
+    }
+#endif
+    transform_column_scalar(in + i, n - i, scale, offset, out + i);
+}
+
+template<typename In, typename Out>
+void transform_rects(const rect_array_t<In>& in, const rect_transform_t& t, rect_array_t<Out>& out)
+{
+    const size_t n = in.size();
+    out.resize(n);
+    transform_column(in.left.data(), n, t.sx, t.ox, out.left.data());
+    transform_column(in.right.data(), n, t.sx, t.ox, out.right.data());
+    transform_column(in.top.data(), n, t.sy, t.oy, out.top.data());
+    transform_column(in.bottom.data(), n, t.sy, t.oy, out.bottom.data());
+}
+
+template<typename In, typename Out>
+void transform_rects_scalar(const rect_array_t<In>& in, const rect_transform_t& t, rect_array_t<Out>& out)
+{
+    const size_t n = in.size();
+    out.resize(n);
+    transform_column_scalar(in.left.data(), n, t.sx, t.ox, out.left.data());
+    transform_column_scalar(in.right.data(), n, t.sx, t.ox, out.right.data());
+    transform_column_scalar(in.top.data(), n, t.sy, t.oy, out.top.data());
+    transform_column_scalar(in.bottom.data(), n, t.sy, t.oy, out.bottom.data());
+}
+
+#endif // _LIBTTWWAM_GEOMETRY_H_
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include "history.h"
+
+using std::make_shared;
+using std::shared_ptr;
+
+history_stats_t _history_stats;
+
+typedef std::vector<shared_ptr<const container_version_t>> container_versions_t;
+
+static std::deque<shared_ptr<const layout_version_t>> _versions;
+static size_t _at = 0;
+
+// what a map node costs on top of its value
+static const size_t MAP_NODE = 4 * sizeof(void*);
+
+// only what's restored counts, titles change all the time. rescans
+// recompute the relative rects, so those may be off by rounding.
+static bool same_window(const window_t& a, const window_t& b)
+{
+    const double eps = 1e-4;
+    return a.hwnd == b.hwnd
+        && a.show == b.show
+        && std::fabs(a.rect.left - b.rect.left) < eps
+        && std::fabs(a.rect.top - b.rect.top) < eps
+        && std::fabs(a.rect.right - b.rect.right) < eps
+        && std::fabs(a.rect.bottom - b.rect.bottom) < eps;
+}
+
+static bool same_container(const container_version_t& v, const container_t& c)
+{
+    if (v.name != c.name || v.focus != c.focus || v.zorder != c.zorder || v.wmap.size() != c.wmap.size()) {
+        return false;
+    }
+    return std::equal(v.wmap.begin(), v.wmap.end(), c.wmap.begin(),
+            [](const window_map_t::value_type& a, const window_map_t::value_type& b) {
+                return same_window(a.second, b.second);
+            });
+}
+
+// the record with `name` in `versions`, which is ordered by name
+static container_versions_t::const_iterator find_record(const container_versions_t& versions, atom_t name)
+{
+    auto it = std::lower_bound(versions.begin(), versions.end(), name,
+            [](const shared_ptr<const container_version_t>& r, atom_t n) {
+                return r->name < n;
+            });
+    return it != versions.end() && (*it)->name == name ? it : versions.end();
+}
+
+void remember_layout()
+{
+    const layout_version_t* prev = _versions.empty() ? nullptr : _versions[_at].get();
+    auto v = make_shared<layout_version_t>();
+    v->containers.reserve(_containers.size());
+    size_t shared = 0;
+    size_t copied = 0;
+    for(const auto& it: _containers) {
+        const container_t& c = *it.second;
+        if (prev) {
+            auto r = find_record(prev->containers, it.first);
+            if (r != prev->containers.end() && same_container(**r, c)) {
+                v->containers.push_back(*r);
+                ++shared;
+                continue;
+            }
+        }
+        v->containers.push_back(make_shared<const container_version_t>(
+                    container_version_t{c.name, c.wmap, c.focus, c.zorder}));
+        v->bytes += sizeof(container_version_t) + c.wmap.size() * (sizeof(window_map_t::value_type) + MAP_NODE)
+            + c.zorder.size() * sizeof(hwnd_t);
+        ++copied;
+    }
+    for(const auto& it: _monitors) {
+        shared_ptr<container_t> c = it.second.lock();
+        if (c) {
+            v->monitors.emplace_back(it.first, c->name);
+        }
+    }
+    if (prev && !copied && v->containers.size() == prev->containers.size() && v->monitors == prev->monitors) {
+        return;
+    }
+    v->bytes += sizeof(layout_version_t) + v->containers.capacity() * sizeof(v->containers[0])
+        + v->monitors.capacity() * sizeof(v->monitors[0]);
+
+    if (!_versions.empty()) {
+        _versions.erase(_versions.begin() + _at + 1, _versions.end());
+    }
+    _versions.push_back(v);
+    if (_versions.size() > HISTORY_VERSIONS) {
+        _versions.pop_front();
+    }
+    _at = _versions.size() - 1;
+    ++_history_stats.recorded;
+    _history_stats.shared += shared;
+    _history_stats.copied += copied;
+}
+
+shared_ptr<const layout_version_t> step_history(int steps)
+{
+    if (_versions.empty()) {
+        return nullptr;
+    }
+    const long target = static_cast<long>(_at) - steps;
+    if (target < 0 || target >= static_cast<long>(_versions.size())) {
+        return nullptr;
+    }
+    _at = static_cast<size_t>(target);
+    return _versions[_at];
+}
+
+size_t history_size()
+{
+    return _versions.size();
+}
+
+size_t history_position()
+{
+    return _versions.empty() ? 0 : _at;
+}
+
+size_t history_bytes()
+{
+    size_t bytes = 0;
+    for(const auto& v: _versions) {
+        bytes += v->bytes;
+    }
+    return bytes;
+}
+
+void history_reset()
+{
+    _versions.clear();
+    _at = 0;
+    _history_stats = history_stats_t();
+}
+
+void mark_history_strings()
+{
+    const layout_version_t* prev = nullptr;
+    for(const auto& v: _versions) {
+        for(const auto& r: v->containers) {
+            // shared with the version before, marked already
+            if (prev) {
+                auto p = find_record(prev->containers, r->name);
+                if (p != prev->containers.end() && *p == r) {
+                    continue;
+                }
+            }
+            _strings.mark(r->name);
+            for(const auto& w: r->wmap) {
+                _strings.mark(w.second.title);
+                _strings.mark(w.second.cls);
+            }
+        }
+        prev = v.get();
+    }
+}
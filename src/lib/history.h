@@ -0,0 +1,64 @@
+#ifndef _LIBTTWWAM_HISTORY_H_
+#define _LIBTTWWAM_HISTORY_H_
+
+// past versions of the containers, for :undo and :redo
+//
+// a version is the list of containers (with their windows' geometry) and
+// which monitor shows which. container records are immutable and shared
+// between consecutive versions as long as the container didn't change, so
+// a version costs its two vectors plus copies of the containers that did.
+// only the last HISTORY_VERSIONS versions are kept.
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "core.h"
+
+const size_t HISTORY_VERSIONS = 256;
+
+// a container as it was. the windows' committed state (shown, placed,
+// hidden_by) is whatever it was at the time and ignored when restoring.
+struct container_version_t {
+    atom_t name;
+    window_map_t wmap;
+    hwnd_t focus;
+    std::vector<hwnd_t> zorder;
+};
+
+struct layout_version_t {
+    // ordered by atom, like _containers
+    std::vector<std::shared_ptr<const container_version_t>> containers;
+    std::vector<std::pair<hmonitor_t, atom_t>> monitors;
+    // memory that isn't shared with the version before
+    size_t bytes = 0;
+};
+
+struct history_stats_t {
+    size_t recorded = 0;
+    // container records reused from the version before, and copied
+    size_t shared = 0;
+    size_t copied = 0;
+    size_t restored = 0;
+    double last_restore_us = 0;
+};
+
+extern history_stats_t _history_stats;
+
+// records the current state as a new version, unless it's the same as the
+// current version. drops the versions that could have been redone.
+void remember_layout();
+// moves `steps` versions back (or forward, if negative) and returns that
+// version, null if there's none
+std::shared_ptr<const layout_version_t> step_history(int steps);
+size_t history_size();
+// index of the current version
+size_t history_position();
+// memory used by all versions
+size_t history_bytes();
+void history_reset();
+// keeps the names and titles of all versions interned
+void mark_history_strings();
+
+#endif // _LIBTTWWAM_HISTORY_H_
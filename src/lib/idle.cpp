@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+
+#include "idle.h"
+
+using std::wstring_view;
+
+typedef std::chrono::steady_clock idle_clock_t;
+
+// when each job is due, kept next to _jobs
+struct idle_schedule_t {
+    idle_clock_t::time_point due;
+    // stopped before it was done, continues on the next turn
+    bool running = false;
+    // of the run in progress
+    double run_us = 0;
+};
+
+static std::vector<idle_job_t> _jobs;
+static std::vector<idle_schedule_t> _schedule;
+
+static double us_since(idle_clock_t::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(idle_clock_t::now() - start).count();
+}
+
+static size_t find_job(wstring_view name)
+{
+    for(size_t i = 0; i < _jobs.size(); ++i) {
+        if (_jobs[i].name == name) {
+            return i;
+        }
+    }
+    return _jobs.size();
+}
+
+void add_idle_job(wstring_view name, int priority, unsigned interval_ms, unsigned slice_us,
+        std::function<idle_result_t()> step)
+{
+    size_t i = find_job(name);
+    if (i == _jobs.size()) {
+        _jobs.emplace_back();
+        _schedule.emplace_back();
+    }
+    _jobs[i] = idle_job_t{std::wstring(name), priority, interval_ms, slice_us, std::move(step), idle_stats_t()};
+    _schedule[i] = idle_schedule_t{idle_clock_t::now()};
+}
+
+void remove_idle_job(wstring_view name)
+{
+    size_t i = find_job(name);
+    if (i < _jobs.size()) {
+        _jobs.erase(_jobs.begin() + static_cast<ptrdiff_t>(i));
+        _schedule.erase(_schedule.begin() + static_cast<ptrdiff_t>(i));
+    }
+}
+
+void wake_idle_job(wstring_view name)
+{
+    size_t i = find_job(name);
+    if (i < _jobs.size() && !_schedule[i].running) {
+        _schedule[i].due = std::min(_schedule[i].due, idle_clock_t::now());
+    }
+}
+
+void idle_reset()
+{
+    for(size_t i = 0; i < _jobs.size(); ++i) {
+        _jobs[i].stats = idle_stats_t();
+        _schedule[i] = idle_schedule_t{idle_clock_t::now()};
+    }
+}
+
+// the due job with the lowest priority, the one waiting longest among equals
+static size_t next_job(idle_clock_t::time_point now)
+{
+    size_t best = _jobs.size();
+    for(size_t i = 0; i < _jobs.size(); ++i) {
+        if (_schedule[i].due > now) {
+            continue;
+        }
+        if (best == _jobs.size() || _jobs[i].priority < _jobs[best].priority
+                || (_jobs[i].priority == _jobs[best].priority && _schedule[i].due < _schedule[best].due)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// runs one step and books it, returns whether the job is done
+static bool step_job(size_t i)
+{
+    idle_job_t& job = _jobs[i];
+    idle_schedule_t& sched = _schedule[i];
+    const auto start = idle_clock_t::now();
+    const idle_result_t r = job.step();
+    const double us = us_since(start);
+
+    ++job.stats.steps;
+    job.stats.total_us += us;
+    job.stats.max_step_us = std::max(job.stats.max_step_us, us);
+    if (us > job.slice_us) {
+        ++job.stats.overruns;
+    }
+    sched.run_us += us;
+    if (r == IDLE_MORE) {
+        sched.running = true;
+        return false;
+    }
+    ++job.stats.runs;
+    job.stats.last_us = sched.run_us;
+    sched.run_us = 0;
+    sched.running = false;
+    sched.due = idle_clock_t::now() + std::chrono::milliseconds(job.interval_ms);
+    return true;
+}
+
+bool run_idle(const std::function<bool()>& input_pending)
+{
+    const auto start = idle_clock_t::now();
+    const size_t i = next_job(start);
+    if (i == _jobs.size()) {
+        return false;
+    }
+    idle_job_t& job = _jobs[i];
+    const std::chrono::microseconds slice(job.slice_us);
+    bool stepped = false;
+    for(;;) {
+        if (input_pending()) {
+            ++job.stats.deferrals;
+            break;
+        }
+        stepped = true;
+        if (step_job(i)) {
+            break;
+        }
+        if (idle_clock_t::now() - start >= slice) {
+            ++job.stats.sliced;
+            break;
+        }
+    }
+    return stepped;
+}
+
+int next_idle_ms()
+{
+    if (_jobs.empty()) {
+        return -1;
+    }
+    const auto now = idle_clock_t::now();
+    auto due = _schedule.front().due;
+    for(const auto& s: _schedule) {
+        due = std::min(due, s.due);
+    }
+    if (due <= now) {
+        return 0;
+    }
+    // rounded up, waking early would just wait again
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(due - now).count();
+    return static_cast<int>(std::min<decltype(ms)>(ms, INT32_MAX));
+}
+
+bool run_idle_step(wstring_view name)
+{
+    size_t i = find_job(name);
+    if (i == _jobs.size()) {
+        return false;
+    }
+    step_job(i);
+    return true;
+}
+
+const std::vector<idle_job_t>& idle_jobs()
+{
+    return _jobs;
+}
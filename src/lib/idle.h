@@ -0,0 +1,73 @@
+#ifndef _LIBTTWWAM_IDLE_H_
+#define _LIBTTWWAM_IDLE_H_
+
+// housekeeping that runs while the message loop has nothing else to do
+//
+// jobs are registered with a priority, how often they're due and a time
+// slice. whenever the queue is empty the frontend's loop calls run_idle(),
+// which gives the most urgent due job one slice: its step is called until
+// it's done, the slice is used up or input arrived. jobs keep a cursor and
+// do a bounded amount of work per step, an interrupted one continues where
+// it stopped on the next idle turn and stays due until it's done.
+//
+// everything here runs on the thread of the loop.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum idle_result_t {
+    IDLE_DONE,
+    IDLE_MORE,
+};
+
+struct idle_stats_t {
+    // completed runs, each may take several turns
+    size_t runs = 0;
+    size_t steps = 0;
+    // turns given up because input arrived
+    size_t deferrals = 0;
+    // turns that used up their slice
+    size_t sliced = 0;
+    // steps that took longer than the whole slice
+    size_t overruns = 0;
+    double total_us = 0;
+    double max_step_us = 0;
+    // of the last completed run
+    double last_us = 0;
+};
+
+struct idle_job_t {
+    std::wstring name;
+    // lower runs first
+    int priority;
+    unsigned interval_ms;
+    unsigned slice_us;
+    std::function<idle_result_t()> step;
+    idle_stats_t stats;
+};
+
+// replaces a job of the same name, the new one is due right away
+void add_idle_job(std::wstring_view name, int priority, unsigned interval_ms, unsigned slice_us,
+        std::function<idle_result_t()> step);
+void remove_idle_job(std::wstring_view name);
+// makes a job due now, e.g. after whatever it cleans up after happened
+void wake_idle_job(std::wstring_view name);
+// everything due again and the stats cleared, the jobs stay
+void idle_reset();
+
+// one turn, `input_pending` is asked before every step. returns whether
+// any step ran.
+bool run_idle(const std::function<bool()>& input_pending);
+// until run_idle() has something to do, 0 if it has now, -1 if there are
+// no jobs
+int next_idle_ms();
+// a single step of job `name` regardless of the time, for the replay
+bool run_idle_step(std::wstring_view name);
+
+const std::vector<idle_job_t>& idle_jobs();
+
+#endif // _LIBTTWWAM_IDLE_H_
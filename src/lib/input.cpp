@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+
+#include "input.h"
+
+// the modifier keys as win32 reports them, generic and left/right
+static const struct {
+    uint32_t vk;
+    uint32_t modifier;
+} MODIFIER_KEYS[] = {
+    {0x10, CONFIG_MOD_SHIFT}, {0xa0, CONFIG_MOD_SHIFT}, {0xa1, CONFIG_MOD_SHIFT},
+    {0x11, CONFIG_MOD_CONTROL}, {0xa2, CONFIG_MOD_CONTROL}, {0xa3, CONFIG_MOD_CONTROL},
+    {0x12, CONFIG_MOD_ALT}, {0xa4, CONFIG_MOD_ALT}, {0xa5, CONFIG_MOD_ALT},
+    {0x5b, CONFIG_MOD_WIN}, {0x5c, CONFIG_MOD_WIN},
+};
+
+static const size_t NO_MODIFIER = sizeof(MODIFIER_KEYS) / sizeof(MODIFIER_KEYS[0]);
+
+static size_t modifier_index(uint32_t vk)
+{
+    for(size_t i = 0; i < NO_MODIFIER; ++i) {
+        if (MODIFIER_KEYS[i].vk == vk) {
+            return i;
+        }
+    }
+    return NO_MODIFIER;
+}
+
+uint32_t input_matcher_t::modifiers() const
+{
+    uint32_t modifiers = 0;
+    for(size_t i = 0; i < NO_MODIFIER; ++i) {
+        if (_down & (1u << i)) {
+            modifiers |= MODIFIER_KEYS[i].modifier;
+        }
+    }
+    return modifiers;
+}
+
+input_action_t input_matcher_t::key(const config_t& config, uint32_t vk, bool down, uint64_t time_us, input_event_t& out)
+{
+    const size_t m = modifier_index(vk);
+    if (m != NO_MODIFIER) {
+        if (down) {
+            _down |= 1u << m;
+        } else {
+            _down &= ~(1u << m);
+        }
+        return INPUT_PASS;
+    }
+    if (!down) {
+        if (vk == _held) {
+            _held = 0;
+        }
+        return INPUT_PASS;
+    }
+    const bool repeat = vk == _held;
+    _held = vk;
+    const uint32_t modifiers = this->modifiers();
+
+    if (_pending.key) {
+        const input_event_t p = _pending;
+        if (repeat && vk == p.key) {
+            return INPUT_SWALLOW;
+        }
+        _pending = input_event_t();
+        // the sequence's modifiers may still be held
+        const bool plain = !modifiers || modifiers == (p.modifiers & ~CONFIG_MOD_NOREPEAT);
+        if (plain && time_us - p.time_us <= INPUT_SEQUENCE_US && config.hotkey_command(p.modifiers, p.key, vk)) {
+            out = p;
+            out.time_us = time_us;
+            out.then = vk;
+            return INPUT_DISPATCH;
+        }
+        // not a sequence after all, the key is handled on its own
+    }
+
+    if (config.sequence_prefix(modifiers, vk)) {
+        if (!repeat) {
+            _pending = {time_us, modifiers, vk, 0};
+        }
+        return INPUT_SWALLOW;
+    }
+    if (!config.hotkey_command(modifiers, vk)) {
+        return INPUT_PASS;
+    }
+    if (repeat) {
+        return INPUT_SWALLOW;
+    }
+    out = {time_us, modifiers, vk, 0};
+    return INPUT_DISPATCH;
+}
+
+void input_stats_t::record(double us)
+{
+    ++dispatched;
+    max_us = std::max(max_us, us);
+    if (_samples.size() < INPUT_SAMPLES) {
+        _samples.push_back(us);
+        return;
+    }
+    _samples[_next] = us;
+    _next = (_next + 1) % INPUT_SAMPLES;
+}
+
+double input_stats_t::percentile(double p) const
+{
+    if (_samples.empty()) {
+        return 0;
+    }
+    std::vector<double> v(_samples);
+    const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+uint64_t input_now_us()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,77 @@
+#ifndef _LIBTTWWAM_INPUT_H_
+#define _LIBTTWWAM_INPUT_H_
+
+// hotkeys and key sequences, recognized off the main thread
+//
+// the input thread sees every key and feeds it to an input_matcher_t,
+// which tracks the modifiers and a pending sequence. completed hotkeys are
+// timestamped and queued for the main thread, a key that starts a sequence
+// is swallowed without waking it. the main thread looks the command up
+// again when dispatching, so a configuration swapped meanwhile wins.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+// how long the second key of a sequence may take
+const uint64_t INPUT_SEQUENCE_US = 2000000;
+// latencies kept for the percentiles
+const size_t INPUT_SAMPLES = 1024;
+
+enum input_action_t {
+    // not ours, let it through
+    INPUT_PASS,
+    // ours, but nothing to run (yet)
+    INPUT_SWALLOW,
+    // a hotkey or sequence completed, queue it
+    INPUT_DISPATCH,
+};
+
+struct input_event_t {
+    // when the last key went down, see input_now_us()
+    uint64_t time_us;
+    uint32_t modifiers;
+    uint32_t key;
+    // the second key of a sequence, 0 for plain hotkeys
+    uint32_t then;
+};
+
+class input_matcher_t {
+public:
+    // a key went down or up. repeats (a key held down) never dispatch.
+    input_action_t key(const config_t& config, uint32_t vk, bool down, uint64_t time_us, input_event_t& out);
+    // the CONFIG_MOD_* held down right now
+    uint32_t modifiers() const;
+    bool pending() const { return _pending.key != 0; }
+
+private:
+    // modifier keys held down, a bit per key
+    uint32_t _down = 0;
+    // the last other key that went down and isn't up yet
+    uint32_t _held = 0;
+    input_event_t _pending = {};
+};
+
+// from key down to the main thread starting to dispatch it
+struct input_stats_t {
+    size_t dispatched = 0;
+    size_t sequences = 0;
+    // the binding was gone once it got dispatched
+    size_t unbound = 0;
+    double max_us = 0;
+
+    void record(double us);
+    // p in [0, 1] over the last INPUT_SAMPLES
+    double percentile(double p) const;
+
+private:
+    std::vector<double> _samples;
+    size_t _next = 0;
+};
+
+// microseconds on the steady clock
+uint64_t input_now_us();
+
+#endif // _LIBTTWWAM_INPUT_H_
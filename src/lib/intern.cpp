@@ -0,0 +1,113 @@
+#include <cwctype>
+#include <functional>
+
+#include "intern.h"
+
+using std::wstring;
+using std::wstring_view;
+
+static size_t hash_view(wstring_view s)
+{
+    return std::hash<wstring_view>()(s);
+}
+
+string_pool_t::string_pool_t()
+{
+    _entries.push_back({wstring(), wstring(), hash_view(wstring_view()), true, true});
+}
+
+void string_pool_t::to_lower(wstring_view in, wstring& out)
+{
+    out.resize(in.size());
+    for(size_t i = 0; i < in.size(); ++i) {
+        out[i] = static_cast<wchar_t>(std::towlower(in[i]));
+    }
+}
+
+atom_t string_pool_t::find(wstring_view s) const
+{
+    if (s.empty()) {
+        return NO_ATOM;
+    }
+    auto range = _index.equal_range(hash_view(s));
+    for(auto it = range.first; it != range.second; ++it) {
+        if (_entries[it->second].str == s) {
+            return it->second;
+        }
+    }
+    return NO_ATOM;
+}
+
+atom_t string_pool_t::intern(wstring_view s)
+{
+    if (s.empty()) {
+        return NO_ATOM;
+    }
+    size_t h = hash_view(s);
+    auto range = _index.equal_range(h);
+    for(auto it = range.first; it != range.second; ++it) {
+        if (_entries[it->second].str == s) {
+            return it->second;
+        }
+    }
+
+    atom_t id;
+    if (_free.empty()) {
+        id = static_cast<atom_t>(_entries.size());
+        _entries.emplace_back();
+    } else {
+        id = _free.back();
+        _free.pop_back();
+    }
+    entry_t& e = _entries[id];
+    e.str.assign(s);
+    to_lower(s, e.lower);
+    e.hash = h;
+    e.live = true;
+    // new strings survive the sweep they were created in
+    e.marked = true;
+    _index.emplace(h, id);
+    return id;
+}
+
+void string_pool_t::mark(atom_t id)
+{
+    _entries[id].marked = true;
+}
+
+size_t string_pool_t::sweep()
+{
+    size_t dropped = 0;
+    for(atom_t id = 1; id < _entries.size(); ++id) {
+        entry_t& e = _entries[id];
+        if (!e.live) {
+            continue;
+        }
+        if (e.marked) {
+            e.marked = false;
+            continue;
+        }
+        auto range = _index.equal_range(e.hash);
+        for(auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                _index.erase(it);
+                break;
+            }
+        }
+        e.live = false;
+        wstring().swap(e.str);
+        wstring().swap(e.lower);
+        _free.push_back(id);
+        ++dropped;
+    }
+    return dropped;
+}
+
+size_t string_pool_t::bytes() const
+{
+    size_t b = 0;
+    for(const auto& e: _entries) {
+        b += sizeof(e) + (e.str.capacity() + e.lower.capacity()) * sizeof(wchar_t);
+    }
+    return b + _index.size() * (sizeof(size_t) + sizeof(atom_t));
+}
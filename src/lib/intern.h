@@ -0,0 +1,59 @@
+#ifndef _LIBTTWWAM_INTERN_H_
+#define _LIBTTWWAM_INTERN_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// small, stable id of an interned string; 0 is always the empty string
+typedef uint32_t atom_t;
+const atom_t NO_ATOM = 0;
+
+// pool of immutable strings (container names, window titles, ...)
+//
+// every distinct string is stored exactly once together with its hash and
+// lowercase form, so callers compare and hash atoms by id and search the
+// lowercase views without allocating. looking up an already interned string
+// never allocates.
+class string_pool_t {
+public:
+    string_pool_t();
+
+    atom_t intern(std::wstring_view s);
+    // returns NO_ATOM if `s` isn't interned (or is empty)
+    atom_t find(std::wstring_view s) const;
+
+    const std::wstring& str(atom_t id) const { return _entries[id].str; }
+    const std::wstring& lower(atom_t id) const { return _entries[id].lower; }
+    size_t hash(atom_t id) const { return _entries[id].hash; }
+
+    // mark & sweep: everything not marked since the last sweep is dropped
+    // and its id is recycled.
+    void mark(atom_t id);
+    size_t sweep();
+
+    size_t size() const { return _entries.size() - _free.size(); }
+    size_t bytes() const;
+
+    static void to_lower(std::wstring_view in, std::wstring& out);
+
+private:
+    struct entry_t {
+        std::wstring str;
+        std::wstring lower;
+        size_t hash;
+        bool live;
+        bool marked;
+    };
+
+    // deque keeps entries (and thus the strings) in place when growing
+    std::deque<entry_t> _entries;
+    std::vector<atom_t> _free;
+    // keyed by the precomputed hash, so rehashing never touches the strings
+    std::unordered_multimap<size_t, atom_t> _index;
+};
+
+#endif // _LIBTTWWAM_INTERN_H_
@@ -1,19 +1,42 @@
 #define WIN32_LEAN_AND_MEAN
 #define UNICODE
 #include <windows.h>
+#include <dwmapi.h>
+#include <psapi.h>
+#include <shellscalingapi.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cwctype>
 #include <codecvt>
+#include <filesystem>
 #include <functional>
 #include <locale>
 #include <map>
 #include <memory>
-#include <regex>
+#include <memory_resource>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "cmdlog.h"
+#include "config.h"
+#include "core.h"
+#include "export.h"
+#include "history.h"
+#include "idle.h"
+#include "input.h"
+#include "pool.h"
+#include "spsc.h"
+#include "status.h"
+#include "task.h"
+#include "throttle.h"
+#include "trace.h"
 #include "ttwwam.h"
 
 using std::function;
@@ -24,9 +47,10 @@ using std::shared_ptr;
 using std::string;
 using std::stringstream;
 using std::to_string;
+using std::unique_ptr;
 using std::weak_ptr;
 using std::wstring;
-using std::wstringstream;
+using std::wstring_view;
 using std::vector;
 
 const LPCWSTR WC_NAME = L"ttwwam-main-cls";
@@ -41,16 +65,28 @@ static HWND hwndLog;
 const DWORD ID_EDITPREVIEW = 100;
 const DWORD ID_EDITLOG = 101;
 const DWORD ID_EDITINPUT = 102;
-const DWORD INPUTHEIGHT = 25;
 const DWORD EN_USER_BASE = 0x8000;
 const DWORD EN_USER_CONFIRM = EN_USER_BASE + 1;
 const DWORD EN_USER_ABORT = EN_USER_BASE + 2;
+const UINT WM_USER_SNAPSHOT = WM_APP + 1;
+const UINT WM_USER_CONFIG = WM_APP + 2;
+const UINT WM_USER_INPUT = WM_APP + 3;
+const UINT WM_USER_CMDLOG = WM_APP + 4;
+const UINT_PTR ID_TIMER_TASKS = 1;
+const UINT FIRST_INPUT_POLL_MS = 15;
+const DWORD FIRST_INPUT_TIMEOUT_MS = 30000;
+const UINT CLOSE_POLL_MS = 50;
+const DWORD CONFIG_SETTLE_MS = 100;
+#ifndef NDEBUG
+const DWORD STALL_MAX_MS = 10000;
+#endif
+// an unassigned key, see keyboard_hook()
+const BYTE VK_MASK = 0xe8;
+const DWORD CLOSE_TIMEOUT_MS = 5000;
 
 // live previews:
 // https://www.victorhurdugaci.com/fancy-windows-previewer
 
-const LPWSTR NL = L"\r\n";
-
 string w2s(const wstring &var)
 {
    static std::locale loc("");
@@ -65,39 +101,43 @@ wstring s2w(const string &var)
    return std::wstring_convert<std::remove_reference<decltype(facet)>::type, wchar_t>(&facet).from_bytes(var);
 }
 
-// trim from start (in place)
-static inline void ltrim(wstring &s) {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) {
-        return !std::isspace(ch);
-    }));
-}
-
-// trim from end (in place)
-static inline void rtrim(wstring &s) {
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) {
-        return !std::isspace(ch);
-    }).base(), s.end());
+// exact, unlike s2w() which goes through the locale. invalid sequences
+// become U+FFFD.
+static wstring utf8_to_w(std::string_view s)
+{
+    wstring out;
+    if (s.empty()) {
+        return out;
+    }
+    const int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), nullptr, 0);
+    out.resize(n);
+    MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), out.data(), n);
+    return out;
 }
 
 // trim from both ends (in place)
-static inline void trim(wstring &s) {
-    ltrim(s);
-    rtrim(s);
+static inline void trim(wstring_view &s) {
+    while (!s.empty() && std::iswspace(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::iswspace(s.back())) {
+        s.remove_suffix(1);
+    }
 }
 
-wstring join_strings(const vector<wstring>& parts, wstring delim=L" ")
+std::pmr::wstring join_strings(const std::pmr::vector<std::pmr::wstring>& parts, wstring_view delim=L" ")
 {
-    wstringstream ss;
+    std::pmr::wstring s(parts.get_allocator());
     bool first = true;
     for(auto it = parts.begin(), eit=parts.end(); it != eit; ++it) {
         if (first) {
             first = false;
         } else {
-            ss << delim;
+            s.append(delim);
         }
-        ss << *it;
+        s.append(*it);
     }
-    return ss.str();
+    return s;
 }
 
 void clear_preview()
@@ -107,459 +147,379 @@ void clear_preview()
     SendMessage(hwndPreview, EM_REPLACESEL, 0, (LPARAM) 0);
 }
 
-void append_log(const wstring& txt, HWND hwnd)
+void append_log(LPCWSTR txt, HWND hwnd)
 {
     int index = GetWindowTextLength(hwnd);
     SendMessage(hwnd, EM_SETSEL, index, index);
-    SendMessage(hwnd, EM_REPLACESEL, 0, (LPARAM) txt.c_str());
+    SendMessage(hwnd, EM_REPLACESEL, 0, (LPARAM) txt);
 }
 
-void log(const wstring& msg, HWND hwnd)
+void log(LPCWSTR msg, HWND hwnd)
 {
     append_log(msg, hwnd);
     append_log(NL, hwnd);
 }
 
-void log_debug(LPCWSTR txt)
+void log(const wstring& msg, HWND hwnd)
 {
-    log(txt, hwndLog);
+    log(msg.c_str(), hwnd);
 }
-void log_debug(const wstring& txt)
+
+void log_debug(LPCWSTR txt)
 {
     log(txt, hwndLog);
 }
 
-void log_info(const wstring& txt)
+void log_info(LPCWSTR txt)
 {
     log(txt, hwndPreview);
 }
 
-template<typename T>
-wstring _w(T in)
-{
-    stringstream ss;
-    ss << in;
-    return s2w(ss.str());
-}
-template<>
-wstring _w<RECT>(RECT r)
+std::pmr::wstring get_edit_text(HWND hwnd, std::pmr::memory_resource* mr)
 {
-    stringstream ss;
-    ss << "("
-        << r.left << ","
-        << r.top << ")-("
-        << r.right << ","
-        << r.bottom << ")";
-    return s2w(ss.str());
+    std::pmr::wstring txt(mr);
+    txt.resize(GetWindowTextLength(hwnd) + 1);
+    int n = GetWindowText(hwnd, &txt[0], static_cast<int>(txt.size()));
+    txt.resize(n > 0 ? n : 0);
+    return txt;
 }
 
-struct drect_t {
-    double left;
-    double top;
-    double right;
-    double bottom;
-};
-
-// quick declaration ... implementation follows
-struct window_t {
-    HWND hwnd;
-    drect_t rect;
-    wstring tostr() const;
-};
-
-struct monitor_t {
-    HMONITOR hmon;
-    HDC hdc;
-    bool valid;
-    MONITORINFOEX info;
-
-    drect_t get_relative_window_rect(HWND hwnd)
-    {
-        RECT r;
-        GetWindowRect(hwnd, &r);
-        const RECT& rm = info.rcMonitor;
-        DWORD w = rm.right - rm.left;
-        DWORD h = rm.bottom - rm.top;
-
-        r.left -= rm.left;
-        r.right -= rm.left;
-        r.top -= rm.top;
-        r.bottom -= rm.top;
-
-        drect_t dr;
-        dr.left = static_cast<double>(r.left) / w;
-        dr.right = static_cast<double>(r.right) / w;
-        dr.top = static_cast<double>(r.top) / h;
-        dr.bottom = static_cast<double>(r.bottom) / h;
-        return dr;
-    }
-
-    RECT get_absolute_window_rect(const window_t& window)
-    {
-        const RECT& rm = info.rcMonitor;
-        DWORD w = rm.right - rm.left;
-        DWORD h = rm.bottom - rm.top;
-
-        const drect_t& in = window.rect;
-        RECT out;
-        out.left = static_cast<LONG>(in.left * w + rm.left);
-        out.right = static_cast<LONG>(in.right * w + rm.left);
-        out.top = static_cast<LONG>(in.top * h + rm.top);
-        out.bottom = static_cast<LONG>(in.bottom * h + rm.top);
-        return out;
-    }
-
-    wstring tostr() const {
-        wstring txt;
-        txt.append(_w(info.rcMonitor));
-        txt.append(L" HMONITOR=");
-        txt.append(_w(hmon));
-        txt.append(L", HDC=");
-        txt.append(_w(hdc));
-        txt.append(L", Name=");
-        txt.append(info.szDevice);
-        return txt;
-    }
-};
-
-wstring get_window_title(HWND hwnd)
+static rect_t to_rect(const RECT& r)
 {
-    // win32 insists to add null terminator :/
-    int l = GetWindowTextLength(hwnd) + sizeof(TCHAR);
-    vector<TCHAR> v;
-    v.resize(l);
-    GetWindowText(hwnd, &v[0], l);
-    wstring title(v.begin(), v.end());
-    title.erase(title.find(L'\0'));
-    return title;
+    rect_t out = {r.left, r.top, r.right, r.bottom};
+    return out;
 }
 
-wstring get_edit_text(HWND hwnd)
+BOOL __stdcall EnumMonitorProc(HMONITOR hmon, HDC hdc, LPRECT rect, LPARAM lpar)
 {
-    return get_window_title(hwnd);
+    reinterpret_cast<vector<hmonitor_t>*>(lpar)->push_back(hmon);
+    return TRUE;
 }
 
-template<>
-wstring _w<drect_t>(drect_t r)
+BOOL __stdcall EnumWindowProc(HWND hwnd, LPARAM lpar)
 {
-    stringstream ss;
-    ss << "("
-        << r.left << ","
-        << r.top << ")-("
-        << r.right << ","
-        << r.bottom << ")";
-    return s2w(ss.str());
+    reinterpret_cast<vector<hwnd_t>*>(lpar)->push_back(hwnd);
+    return TRUE;
 }
 
-monitor_t get_monitor_info(HMONITOR hmon)
-{
-    monitor_t mon = {hmon};
-    mon.info.cbSize = sizeof(MONITORINFOEX);
-    mon.valid = true;
-    if (!GetMonitorInfo(hmon, &mon.info)) {
-        mon.valid = false;
+// the real window system
+class win32_winsys_t : public winsys_t {
+public:
+    void enum_monitors(vector<hmonitor_t>& out) override
+    {
+        out.clear();
+        EnumDisplayMonitors(NULL, NULL, EnumMonitorProc, reinterpret_cast<LPARAM>(&out));
     }
-    return mon;
-}
-
-HMONITOR current_monitor_handle()
-{
-    POINT pt;
-    GetCursorPos(&pt);
-    return MonitorFromPoint(pt, MONITOR_DEFAULTTONULL);
-}
-
-monitor_t current_monitor()
-{
-    return get_monitor_info(current_monitor_handle());
-}
-
-wstring window_t::tostr() const {
-    wstring txt;
-    txt.append(_w(rect));
-    txt.append(L" ");
-    txt.append(_w(current_monitor().get_absolute_window_rect(*this)));
-    txt.append(L" ");
-    txt.append(L" HWND=");
-    txt.append(_w(hwnd));
-    txt.append(L" ");
-    txt.append(L" Title=");
-    txt.append(get_window_title(hwnd));
-    return txt;
-}
 
-// bool window_title_is(HWND hwnd, const wstring& title)
-// {
-//     if(GetWindowTextLength(hwnd) != title.size()) {
-//         return false;
-//     }
-//     return get_window_title(hwnd) == title;
-// }
-
-typedef map<HWND, window_t> window_map_t;
-
-struct container_t {
-    wstring name;
-    // weak_ptr<monitor_t> mon;
-    window_map_t wmap;
-
-    container_t(wstring name)
-        : name(name)
-    {}
+    bool monitor_info(hmonitor_t hmon, monitor_info_t& info) override
+    {
+        MONITORINFOEX mi;
+        mi.cbSize = sizeof(MONITORINFOEX);
+        if (!GetMonitorInfo(hmon, &mi)) {
+            return false;
+        }
+        info.rect = to_rect(mi.rcMonitor);
+        info.work = to_rect(mi.rcWork);
+        info.device = mi.szDevice;
+
+        DISPLAY_DEVICE dd;
+        dd.cb = sizeof(dd);
+        if (EnumDisplayDevices(mi.szDevice, 0, &dd, EDD_GET_DEVICE_INTERFACE_NAME)) {
+            info.path = dd.DeviceID;
+        } else {
+            info.path.clear();
+        }
 
-    wstring tostr() const {
-        wstring txt;
-        txt.append(name);
-        txt.append(NL);
-        for(const auto& it: wmap)
-        {
-            txt.append(it.second.tostr());
-            txt.append(NL);
+        UINT dpix, dpiy;
+        if (GetDpiForMonitor(hmon, MDT_EFFECTIVE_DPI, &dpix, &dpiy) == S_OK) {
+            info.dpi = dpix;
+        } else {
+            info.dpi = 96;
         }
-        return txt;
+        return true;
     }
-};
 
-typedef map<wstring, shared_ptr<container_t>> container_map_t;
-static container_map_t _containers;
-
-typedef map<HMONITOR, weak_ptr<container_t>> monitor_map_t;
-static monitor_map_t _monitors;
-
-shared_ptr<container_t> current_container()
-{
-    HMONITOR hmon = current_monitor_handle();
-    return _monitors[hmon].lock();
-}
-
-void show_hide_window(HWND hwnd, bool show)
-{
-    ShowWindow(hwnd, show ? SW_SHOW : SW_HIDE);
-}
+    hmonitor_t cursor_monitor() override
+    {
+        POINT pt;
+        GetCursorPos(&pt);
+        return MonitorFromPoint(pt, MONITOR_DEFAULTTONULL);
+    }
 
-// bool is_program_manager(HWND hwnd)
-// {
-//     static const wstring title = L"Program Manager";
-//     return window_title_is(hwnd, title);
-// }
+    void enum_windows(vector<hwnd_t>& out) override
+    {
+        out.clear();
+        EnumWindows(EnumWindowProc, reinterpret_cast<LPARAM>(&out));
+    }
 
-bool ignore_window(HWND hwnd)
-{
-    if (GetShellWindow() == hwnd) {
-        return true;
+    hwnd_t shell_window() override
+    {
+        return GetShellWindow();
     }
-    if (hwnd == hwndMain) {
-        return true;
+
+    bool is_window(hwnd_t hwnd) override
+    {
+        return IsWindow(hwnd) != FALSE;
     }
-    if (!IsWindowVisible(hwnd)) {
+
+    bool is_visible(hwnd_t hwnd) override
+    {
+        if (!IsWindowVisible(hwnd)) {
+            return false;
+        }
+        // cloaked by us, or on another of the built-in virtual desktops
+        DWORD cloaked = 0;
+        if (DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked)) == S_OK && cloaked) {
+            return false;
+        }
         return true;
     }
-    if (!GetWindowTextLength(hwnd)) {
-        return true;
+
+    int title_length(hwnd_t hwnd) override
+    {
+        return GetWindowTextLength(hwnd);
     }
-    // if (is_program_manager(hwnd)) {
-    //     return true;
-    // }
-    return false;
-}
 
-wstring new_container_name() {
-    int i = 0;
-    wstring name;
-    if (_containers.empty()) {
-        return L"main";
+    void title(hwnd_t hwnd, wstring& out) override
+    {
+        // win32 insists to add null terminator :/
+        int l = GetWindowTextLength(hwnd) + 1;
+        out.resize(l);
+        int n = GetWindowText(hwnd, &out[0], l);
+        out.resize(n > 0 ? n : 0);
     }
-    do {
-        ++i;
-        name =  L"cont " + _w(i);
-    } while(_containers.find(name) != _containers.end());
-    return name;
-}
 
-shared_ptr<container_t> new_container(wstring name=L"")
-{
-    if (name.empty()) {
-        name = new_container_name();
+    hmonitor_t window_monitor(hwnd_t hwnd) override
+    {
+        return MonitorFromWindow(hwnd, MONITOR_DEFAULTTONULL);
     }
-    if (_containers.find(name) != _containers.end()) {
-        return shared_ptr<container_t>();
+
+    bool window_rect(hwnd_t hwnd, rect_t& r) override
+    {
+        RECT wr;
+        if (!GetWindowRect(hwnd, &wr)) {
+            return false;
+        }
+        r = to_rect(wr);
+        return true;
     }
-    shared_ptr<container_t> c = make_shared<container_t>(name);
-    _containers[name] = c;
-    return c;
-}
 
-bool delete_container(shared_ptr<container_t> c)
-{
-    if (!c) {
-        return false;
+    window_show_t window_show_state(hwnd_t hwnd) override
+    {
+        if (IsIconic(hwnd)) {
+            return WINDOW_MINIMIZED;
+        }
+        if (IsZoomed(hwnd)) {
+            return WINDOW_MAXIMIZED;
+        }
+        return WINDOW_NORMAL;
     }
 
-    _containers.erase(c->name);
-    return true;
-}
+    void window_class(hwnd_t hwnd, wstring& out) override
+    {
+        // class names are limited to 256 characters
+        wchar_t buf[257];
+        int n = GetClassName(hwnd, buf, 257);
+        out.assign(buf, n > 0 ? n : 0);
+    }
 
-map<HMONITOR, HWND> _trackers;
+    void show_window(hwnd_t hwnd, bool show) override
+    {
+        ShowWindow(hwnd, show ? SW_SHOW : SW_HIDE);
+    }
 
-HWND create_tracking_window(const monitor_t& mon)
-{
-    DWORD dwStyle = WS_CLIPSIBLINGS | WS_CLIPCHILDREN | WS_POPUP;
-    DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_TOPMOST;
-    HWND hwnd = CreateWindowEx(
-            dwExStyle,
-            L"EDIT",
-            NULL,
-            dwStyle,
-            mon.info.rcMonitor.left,
-            mon.info.rcMonitor.top,
-            0, 0,
-            NULL, NULL, NULL, NULL);
-    wstring txt(L"tracking HMONITOR=");
-    txt.append(_w(mon.hmon));
-    txt.append(L" with HWND=");
-    txt.append(_w(hwnd));
-    log_debug(txt);
-    return hwnd;
-}
+    uint32_t window_process(hwnd_t hwnd) override
+    {
+        DWORD pid = 0;
+        GetWindowThreadProcessId(hwnd, &pid);
+        return pid;
+    }
 
-BOOL __stdcall EnumWindowProc(HWND hwnd, LPARAM lpar)
-{
-    if (ignore_window(hwnd)) {
-        return TRUE;
+    bool cloak_window(hwnd_t hwnd, bool cloak) override
+    {
+        BOOL value = cloak ? TRUE : FALSE;
+        return DwmSetWindowAttribute(hwnd, DWMWA_CLOAK, &value, sizeof(value)) == S_OK;
     }
 
-    HMONITOR hmon = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONULL);
-    if (!hmon) {
-        return TRUE;
+    void move_window(hwnd_t hwnd, const rect_t& r) override
+    {
+        MoveWindow(
+                hwnd,
+                static_cast<int>(r.left),
+                static_cast<int>(r.top),
+                static_cast<int>(r.right-r.left),
+                static_cast<int>(r.bottom-r.top),
+                TRUE);
     }
 
-    monitor_t mon = get_monitor_info(hmon);
+    void close_window(hwnd_t hwnd) override
+    {
+        PostMessage(hwnd, WM_CLOSE, 0, 0);
+    }
 
-    const auto tit = _trackers.find(hmon);
-    if (tit == _trackers.end()) {
-        _trackers[hmon] = create_tracking_window(mon);
+    hwnd_t foreground_window() override
+    {
+        return GetForegroundWindow();
     }
 
-    monitor_map_t &mm = *reinterpret_cast<monitor_map_t*>(lpar);
-    shared_ptr<container_t> cont = mm[hmon].lock();
-    if (!cont) {
-        cont = new_container();
-        if (!cont) {
-            return TRUE;
+    void restack_windows(const vector<hwnd_t>& windows, hwnd_t focus) override
+    {
+        const UINT flags = SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE | SWP_NOOWNERZORDER;
+        HDWP dwp = BeginDeferWindowPos(static_cast<int>(windows.size()));
+        HWND after = HWND_TOP;
+        for(hwnd_t hwnd: windows) {
+            if (dwp) {
+                dwp = DeferWindowPos(dwp, hwnd, after, 0, 0, 0, 0, flags);
+            }
+            after = hwnd;
+        }
+        if (!dwp || !EndDeferWindowPos(dwp)) {
+            // a window refused (or is gone), the batch was dropped
+            after = HWND_TOP;
+            for(hwnd_t hwnd: windows) {
+                SetWindowPos(hwnd, after, 0, 0, 0, 0, flags);
+                after = hwnd;
+            }
+        }
+        if (focus) {
+            SetForegroundWindow(focus);
         }
-        mm[hmon] = cont;
     }
 
-    drect_t r = mon.get_relative_window_rect(hwnd);
-    window_t w = {hwnd, r};
-    cont->wmap[hwnd] = w;
-    return TRUE;
-}
-
-bool show_hide_container(shared_ptr<container_t> c, bool show)
-{
-    if (!c) {
-        return false;
+    void process_name(uint32_t pid, wstring& out) override
+    {
+        out.clear();
+        HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!h) {
+            return;
+        }
+        wchar_t buf[MAX_PATH];
+        DWORD n = MAX_PATH;
+        if (QueryFullProcessImageName(h, 0, buf, &n)) {
+            wstring_view path(buf, n);
+            size_t sep = path.find_last_of(L"\\/");
+            out.assign(sep == wstring_view::npos ? path : path.substr(sep + 1));
+        }
+        CloseHandle(h);
     }
 
-    for(const auto& we : c->wmap) {
-        show_hide_window(we.second.hwnd, show);
+    bool process_usage(uint32_t pid, process_usage_t& out) override
+    {
+        HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!h) {
+            return false;
+        }
+        FILETIME created, exited, kernel, user;
+        PROCESS_MEMORY_COUNTERS pmc;
+        pmc.cb = sizeof(pmc);
+        bool ok = GetProcessTimes(h, &created, &exited, &kernel, &user)
+            && K32GetProcessMemoryInfo(h, &pmc, sizeof(pmc));
+        if (ok) {
+            // 100ns units
+            out.cpu_us = (filetime_ticks(kernel) + filetime_ticks(user)) / 10;
+            out.working_set = pmc.WorkingSetSize;
+        }
+        CloseHandle(h);
+        return ok;
     }
-    return true;
-}
 
-void show_hide_current_container(bool show)
-{
-    show_hide_container(current_container(), show);
-}
+    bool throttle_process(uint32_t pid, bool throttle, bool trim) override
+    {
+        DWORD access = PROCESS_SET_INFORMATION | PROCESS_QUERY_LIMITED_INFORMATION;
+        if (trim) {
+            access |= PROCESS_SET_QUOTA;
+        }
+        HANDLE h = OpenProcess(access, FALSE, pid);
+        if (!h) {
+            return false;
+        }
 
-void scan_monitors()
-{
-    // trying to associate monitors after changes to the display configuration
-    // were made. probably doesn't handle resolution-only changes.
-    for(auto it = _trackers.cbegin(); it != _trackers.end();) {
-        HMONITOR hmon = MonitorFromWindow(it->second, MONITOR_DEFAULTTONULL);
-        if (hmon != it->first) {
-            // monitor was removed or re-enumerated, let's check if we have a
-            // container to hide
+        // efficiency mode, or back to letting the system decide
+        PROCESS_POWER_THROTTLING_STATE state = {};
+        state.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+        if (throttle) {
+            state.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+            state.StateMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+        }
+        bool ok = SetProcessInformation(h, ProcessPowerThrottling, &state, sizeof(state)) != FALSE;
 
-            auto mit = _monitors.find(it->first);
-            if (mit != _monitors.end()) {
-                if (hmon) {
-                    // since we had a container displayed there, we move
-                    // it to the new monitor (handle)
-                    _monitors[hmon] = mit->second;
-                } else {
-                    // the monitor is gone, hide the container
-                    show_hide_container(mit->second.lock(), false);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (throttle) {
+                DWORD cls = GetPriorityClass(h);
+                const bool saved = cls && _priorities.emplace(pid, cls).second;
+                if (SetPriorityClass(h, IDLE_PRIORITY_CLASS)) {
+                    // either half is enough to need restoring
+                    ok = true;
+                } else if (saved) {
+                    _priorities.erase(pid);
+                }
+            } else {
+                auto it = _priorities.find(pid);
+                if (it != _priorities.end()) {
+                    SetPriorityClass(h, it->second);
+                    _priorities.erase(it);
                 }
             }
-
-            if (!hmon) {
-                // monitor was removed, destroy the tracker window
-                DestroyWindow(it->second);
-            }
-            // remove monitor and tracker entries
-            _monitors.erase(it->first);
-            _trackers.erase(it++);
-        } else {
-            ++it;
         }
-    }
 
-    // should implicitly be covered by above loop
-    // for(auto it = _monitors.cbegin(); it != _monitors.cend();) {
-    //     if (!get_monitor_info(it->first).valid) {
-    //         _monitors.erase(it++);
-    //     } else {
-    //         ++it;
-    //     }
-    // }
-}
-
-void scan_current_desktops()
-{
-    scan_monitors();
-    EnumWindows(EnumWindowProc, reinterpret_cast<LPARAM>(&_monitors));
-}
-
-bool move_to_monitor(shared_ptr<container_t> c, HMONITOR hmon)
-{
-    if (!c || !hmon) {
-        return false;
+        if (throttle && trim) {
+            SetProcessWorkingSetSizeEx(h, static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1), 0);
+        }
+        CloseHandle(h);
+        return ok;
     }
 
-    // drop container from another monitor where it's currently visible?
-    for(auto it = _monitors.cbegin(); it != _monitors.end();) {
-        shared_ptr<container_t> mc = it->second.lock();
-        if (c == mc) {
-            _monitors.erase(it++);
-        } else {
-            ++it;
-        }
+private:
+    static uint64_t filetime_ticks(const FILETIME& ft)
+    {
+        return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
     }
 
-    monitor_t mon = get_monitor_info(hmon);
+    std::mutex _mutex;
+    // priority classes of throttled processes, to restore them
+    map<uint32_t, DWORD> _priorities;
+};
 
-    for(const auto& e: c->wmap) {
-        const window_t& window = e.second;
-        RECT r = mon.get_absolute_window_rect(window);
-        MoveWindow(
-                window.hwnd,
-                static_cast<int>(r.left),
-                static_cast<int>(r.top),
-                static_cast<int>(r.right-r.left),
-                static_cast<int>(r.bottom-r.top),
-                TRUE);
-    }
+static win32_winsys_t _win32;
+// only set up when started with --trace <file>
+static unique_ptr<trace_writer_t> _trace_writer;
+static unique_ptr<recording_winsys_t> _recorder;
+
+// see config.h
+static std::filesystem::path _config_path;
+static int _input_height = config_t().input_height;
+
+// see input.h. hotkeys come from the hook on the input thread, or from
+// RegisterHotKey() if it couldn't be installed.
+static spsc_queue_t<input_event_t, 256> _input_queue;
+static input_matcher_t _input_matcher;
+static std::atomic<bool> _input_hooked{false};
+// set while a WM_USER_INPUT is on its way
+static std::atomic<bool> _input_posted{false};
+static std::atomic<size_t> _input_dropped{0};
+static DWORD _input_thread_id;
+static input_stats_t _input_stats;
+
+// the commands typed so far, next to the configuration
+static command_log_t _command_log;
+
+// walking the command log from the input box, with up/down or CTRL+R
+struct recall_t {
+    // the entry shown, _command_log.size() past the newest
+    size_t at = 0;
+    bool walking = false;
+    // what was typed before, shown again past the newest
+    wstring draft;
+    bool searching = false;
+    wstring needle;
+};
 
-    _monitors[hmon] = c;
-    return true;
-}
+static recall_t _recall;
 
-bool move_to_current_monitor(shared_ptr<container_t> c)
+static void reset_recall()
 {
-    return move_to_monitor(c, current_monitor_handle());
+    _recall = recall_t();
 }
 
 wstring get_last_error_message()
@@ -592,47 +552,105 @@ void log_error(LPCWSTR txt)
 
 bool show_main_window(HWND hwnd, bool show)
 {
-    show_hide_window(hwnd, show);
+    if (show) {
+        remember_focus();
+    }
+    ShowWindow(hwnd, show ? SW_SHOW : SW_HIDE);
     if (!show) {
         return false;
     }
 
-    scan_current_desktops();
+    // don't wait for a scan, the latest snapshot is recent enough for the
+    // preview and a fresh one is on its way
+    apply_latest_snapshot();
+    _scanner.request();
 
     monitor_t m = current_monitor();
     log_debug(m.tostr());
 
-    const int W = (m.info.rcMonitor.right - m.info.rcMonitor.left) / 2;
-    const int H = (m.info.rcMonitor.bottom - m.info.rcMonitor.top) / 2;
+    const int W = (m.info.rect.right - m.info.rect.left) / 2;
+    const int H = (m.info.rect.bottom - m.info.rect.top) / 2;
     MoveWindow(
             hwnd,
-            m.info.rcMonitor.right - W,
-            m.info.rcMonitor.bottom - H,
+            m.info.rect.right - W,
+            m.info.rect.bottom - H,
             W,
             H,
             FALSE);
     SetWindowText(hwndInput, L"");
+    reset_recall();
     SetFocus(hwndInput);
     SetForegroundWindow(hwnd);
 
     return true;
 }
 
-struct hotkey_t {
-    SHORT modifier;
-    SHORT keycode;
-};
-
+// parsed command, allocated from the event arena
 struct cmd_t {
-    wstring cmd;
-    vector<wstring> args;
+    std::pmr::wstring cmd;
+    std::pmr::vector<std::pmr::wstring> args;
+
+    explicit cmd_t(std::pmr::memory_resource* mr)
+        : cmd(mr), args(mr)
+    {}
 };
 
+// commands either run right away (`func`) or as a task that may wait
+// (`task`), both return whether to hide the main window. tasks get their
+// own copy of the command, the event arena is gone once they resume.
 struct cmd_spec_t {
-    pair<bool, hotkey_t> hotkey;
-    function<bool(HWND, cmd_t)> func;
+    function<bool(HWND, const cmd_t&)> func;
+    function<task_t(HWND, cmd_t)> task;
 };
 
+// tasks waiting for a scan, with scans_started() when they requested it
+static vector<pair<uint64_t, uint64_t>> _scan_waiters;
+
+// `co_await scanned_t()` requests a scan and resumes once a snapshot whose
+// build started after that got applied, one already running when it's
+// requested saw the windows from before. the scan runs on the scanner
+// thread, the loop keeps going.
+struct scanned_t {
+    bool await_ready() const { return false; }
+    void await_suspend(task_t::handle_t h)
+    {
+        _scan_waiters.emplace_back(scans_started(), h.promise().id);
+        _scanner.request();
+    }
+    void await_resume() const {}
+};
+
+void snapshot_applied()
+{
+    auto it = std::remove_if(_scan_waiters.begin(), _scan_waiters.end(), [](const pair<uint64_t, uint64_t>& w) {
+        if (_applied_scan <= w.first) {
+            return false;
+        }
+        wake_task(w.second);
+        return true;
+    });
+    _scan_waiters.erase(it, _scan_waiters.end());
+}
+
+// whether the idle jobs have to yield, anything in the queue (timers
+// included) comes first
+static bool input_pending()
+{
+    return HIWORD(GetQueueStatus(QS_ALLINPUT)) != 0;
+}
+
+// (re)arms the timer that drives the tasks. WM_TIMER is the message with
+// the lowest priority, so input always gets handled between two steps.
+void schedule_tasks(HWND hwnd)
+{
+    int ms = next_task_ms();
+    if (ms < 0) {
+        KillTimer(hwnd, ID_TIMER_TASKS);
+        return;
+    }
+    SetTimer(hwnd, ID_TIMER_TASKS, std::max<UINT>(ms, USER_TIMER_MINIMUM), NULL);
+}
+
 bool cmd_quit_program(HWND hwnd, const cmd_t& cmd)
 {
     PostQuitMessage(0);
@@ -643,54 +661,100 @@ bool cmd_quit_program(HWND hwnd, const cmd_t& cmd)
 bool cmd_new_desktop(HWND hwnd, const cmd_t& cmd)
 {
     scan_current_desktops();
+    remember_layout();
     shared_ptr<container_t> c = current_container();
     show_hide_container(c, false);
     if (!c || !c->wmap.empty()) {
         c = new_container();
         _monitors[current_monitor_handle()] = c;
+        publish_status();
     }
+    remember_layout();
     show_main_window(hwnd, false);
     return true;
 }
 
-bool switch_to_desktop(HWND hwnd, const wstring& name)
-{
-    log_debug(wstring(L"Switching to container ") + name);
-    shared_ptr<container_t> current = current_container();
-    if (current && (name == current->name)) {
-        log_debug(L"oh, we're already on the correct container");
-        return true;
-    }
+// how long it takes after a switch until the user does something, that is
+// how usable the desktop was right away
+struct first_input_stats_t {
+    size_t count = 0;
+    // the focused window still was the one the switch focused
+    size_t focus_kept = 0;
+    double total_ms = 0;
+    DWORD last_ms = 0;
+};
+static first_input_stats_t _first_input;
 
-    shared_ptr<container_t> next;
-    auto it = _containers.find(name);
-    if (it == _containers.end()) {
-        log_debug(L"container not found, creating a new one");
-        next = new_container(name);
-    } else {
-        next = it->second;
+// polls for the first input after a switch, the next switch cancels it
+task_t measure_first_input()
+{
+    const DWORD switched = GetTickCount();
+    LASTINPUTINFO li;
+    li.cbSize = sizeof(li);
+    // the key that confirmed the switch is still down
+    do {
+        co_await task_sleep_t(FIRST_INPUT_POLL_MS);
+        if (GetTickCount() - switched > FIRST_INPUT_TIMEOUT_MS) {
+            co_return false;
+        }
+    } while (GetAsyncKeyState(VK_RETURN) & 0x8000);
+    GetLastInputInfo(&li);
+    const DWORD baseline = li.dwTime;
+    do {
+        co_await task_sleep_t(FIRST_INPUT_POLL_MS);
+        if (GetTickCount() - switched > FIRST_INPUT_TIMEOUT_MS) {
+            co_return false;
+        }
+        GetLastInputInfo(&li);
+    } while (li.dwTime == baseline);
+    _first_input.last_ms = li.dwTime - switched;
+    _first_input.total_ms += _first_input.last_ms;
+    ++_first_input.count;
+    if (switched_focus() && GetForegroundWindow() == switched_focus()) {
+        ++_first_input.focus_kept;
     }
+    co_return true;
+}
 
-    if (!next) {
-        log_debug(wstring(L"container not found: ") + name);
-        return false;
+// the layout is still committed in one step, so nothing is ever half
+// switched, but the scan it needs runs on the scanner thread
+task_t switch_and_measure(HWND hwnd, wstring name)
+{
+    co_await scanned_t();
+    if (!switch_to_desktop(name, false)) {
+        co_return false;
     }
+    start_task("first_input", measure_first_input());
+    co_return true;
+}
 
-    scan_current_desktops();
-    show_hide_container(current, false);
-    move_to_current_monitor(next);
-
-    if (current && current->wmap.empty()) {
-        delete_container(current);
-    }
-    show_hide_container(next, true);
-    return true;
+task_t cmd_switch_to_desktop(HWND hwnd, cmd_t cmd)
+{
+    return switch_and_measure(hwnd, wstring(join_strings(cmd.args)));
 }
 
-bool cmd_switch_to_desktop(HWND hwnd, const cmd_t& cmd)
+// :move <container> focus|title|class|process <pattern>
+task_t cmd_move_windows(HWND hwnd, cmd_t cmd)
 {
-    wstring name = join_strings(cmd.args);
-    return switch_to_desktop(hwnd, name);
+    static const pair<const wchar_t*, window_match_t> matches[] = {
+        {L"focus", MATCH_FOCUS}, {L"title", MATCH_TITLE}, {L"class", MATCH_CLASS}, {L"process", MATCH_PROCESS},
+    };
+    const auto m = cmd.args.size() < 2 ? std::end(matches) : std::find_if(std::begin(matches), std::end(matches),
+            [&cmd](const pair<const wchar_t*, window_match_t>& m) {
+                return cmd.args[1] == m.first;
+            });
+    if (m == std::end(matches) || (m->second != MATCH_FOCUS && cmd.args.size() < 3)) {
+        log_debug(L"usage: :move <container> focus|title|class|process <pattern>");
+        co_return false;
+    }
+    // copied before waiting, the arena is gone by then
+    const window_match_t match = m->second;
+    const wstring target(cmd.args[0]);
+    std::pmr::vector<std::pmr::wstring> rest(cmd.args.begin() + 2, cmd.args.end(), cmd.args.get_allocator());
+    const wstring pattern(join_strings(rest));
+
+    co_await scanned_t();
+    co_return move_windows(match, pattern, target) > 0;
 }
 
 bool cmd_show_main_window(HWND hwnd, const cmd_t& cmd)
@@ -699,14 +763,14 @@ bool cmd_show_main_window(HWND hwnd, const cmd_t& cmd)
     // return false to prevent immediately getting closed again ;)
     shared_ptr<container_t> c = current_container();
     if (c) {
-        log_debug(wstring(L"current container = ") + c->name + L" with " + _w(c->wmap.size()) + L" windows");
+        log_debug(wstring(L"current container = ") + _strings.str(c->name) + L" with " + _w(c->wmap.size()) + L" windows");
     }
     return false;
 }
 
 bool cmd_rename_current_container(HWND hwnd, const cmd_t& cmd)
 {
-    wstring name = join_strings(cmd.args);
+    std::pmr::wstring name = join_strings(cmd.args);
     if (name.empty()) {
         return false;
     }
@@ -714,50 +778,249 @@ bool cmd_rename_current_container(HWND hwnd, const cmd_t& cmd)
     if (!c) {
         return false;
     }
-    if (_containers.find(name) != _containers.end()) {
+    if (find_container(name)) {
         return false;
     }
-    _containers.erase(c->name);
-    c->name = name;
-    _containers[name] = c;
+    remember_layout();
+    // re-key the existing node, no need to reallocate it
+    auto node = _containers.extract(c->name);
+    c->name = _strings.intern(name);
+    node.key() = c->name;
+    _containers.insert(std::move(node));
+    publish_status();
+    remember_layout();
     return true;
 }
 
-bool cmd_scan_desktops(HWND hwnd, const cmd_t cmd)
+task_t cmd_scan_desktops(HWND hwnd, cmd_t cmd)
 {
-    scan_current_desktops();
-    return false;
+    co_await scanned_t();
+    log_debug(L"scanned, snapshot #" + _w(_applied_generation));
+    co_return false;
 }
 
-bool cmd_kill_windows(HWND hwnd, const cmd_t cmd)
+// asks the windows to close and waits for them to go away
+task_t cmd_kill_windows(HWND hwnd, cmd_t cmd)
 {
     shared_ptr<container_t> c = current_container();
     if (!c) {
-        return false;
+        co_return false;
     }
+    vector<hwnd_t> windows;
     for(const auto& w: c->wmap) {
-        PostMessage(w.second.hwnd, WM_CLOSE, 0, 0);
+        windows.push_back(w.second.hwnd);
+        winsys().close_window(w.second.hwnd);
     }
 
-    return true;
+    const DWORD start = GetTickCount();
+    size_t open = windows.size();
+    while (open && GetTickCount() - start < CLOSE_TIMEOUT_MS) {
+        co_await task_sleep_t(CLOSE_POLL_MS);
+        open = std::count_if(windows.begin(), windows.end(), [](hwnd_t hwnd) {
+            return winsys().is_window(hwnd);
+        });
+    }
+    if (open) {
+        log_debug(_w(open) + L" of " + _w(windows.size()) + L" windows didn't close");
+    }
+    // the prune job drops the closed ones from the container
+    wake_idle_job(L"prune");
+    co_return true;
 }
 
-bool cmd_delete_desktop(HWND hwnd, const cmd_t cmd)
+bool cmd_delete_desktop(HWND hwnd, const cmd_t& cmd)
 {
     shared_ptr<container_t> c = current_container();
+    remember_layout();
     show_hide_container(c, true);
-    return delete_container(c);
+    bool deleted = delete_container(c);
+    remember_layout();
+    return deleted;
+}
+
+bool cmd_undo(HWND hwnd, const cmd_t& cmd)
+{
+    return undo_layout();
+}
+
+bool cmd_redo(HWND hwnd, const cmd_t& cmd)
+{
+    return redo_layout();
 }
 
-bool cmd_info(HWND hwnd, const cmd_t cmd)
+// :hide_with <hide|cloak> [window class]
+bool cmd_hide_with(HWND hwnd, const cmd_t& cmd)
 {
-    for(const auto& it: _trackers) {
-        wstring txt(L"tracking HWND=");
-        txt.append(_w(it.second));
-        txt.append(L" was on HMONITOR=");
+    if (cmd.args.empty()) {
+        return false;
+    }
+    hide_strategy_t strategy;
+    if (cmd.args[0] == L"hide") {
+        strategy = HIDE_SHOW_WINDOW;
+    } else if (cmd.args[0] == L"cloak") {
+        strategy = HIDE_CLOAK;
+    } else {
+        log_debug(L"unknown hide strategy, use hide or cloak");
+        return false;
+    }
+    std::pmr::vector<std::pmr::wstring> cls(cmd.args.begin() + 1, cmd.args.end(), cmd.args.get_allocator());
+    set_hide_strategy(join_strings(cls), strategy);
+    return true;
+}
+
+#ifndef NDEBUG
+// :stall [ms] blocks the main thread, to see what input does meanwhile.
+// debug builds only.
+bool cmd_stall(HWND hwnd, const cmd_t& cmd)
+{
+    DWORD ms = 1000;
+    if (!cmd.args.empty()) {
+        ms = static_cast<DWORD>(std::wcstoul(cmd.args[0].c_str(), nullptr, 10));
+    }
+    Sleep(std::min(ms, STALL_MAX_MS));
+    return false;
+}
+#endif
+
+// :alloc on|off|reset
+bool cmd_alloc(HWND hwnd, const cmd_t& cmd)
+{
+    if (cmd.args.size() != 1) {
+        return false;
+    }
+    if (cmd.args[0] == L"on") {
+        alloc_tracking(true);
+    } else if (cmd.args[0] == L"off") {
+        alloc_tracking(false);
+    } else if (cmd.args[0] == L"reset") {
+        reset_alloc_stats();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// :throttle on|off|trim|notrim|allow <exe>|deny <exe>|clear
+bool cmd_throttle(HWND hwnd, const cmd_t& cmd)
+{
+    if (cmd.args.empty()) {
+        return false;
+    }
+    wstring_view what(cmd.args[0]);
+    wstring exe;
+    if (cmd.args.size() > 1) {
+        string_pool_t::to_lower(cmd.args[1], exe);
+    }
+    if (what == L"on") {
+        _throttle_policy.enabled = true;
+    } else if (what == L"off") {
+        _throttle_policy.enabled = false;
+        restore_all_processes();
+    } else if (what == L"trim") {
+        _throttle_policy.trim = true;
+    } else if (what == L"notrim") {
+        _throttle_policy.trim = false;
+    } else if (what == L"allow" && !exe.empty()) {
+        _throttle_policy.allow.insert(exe);
+    } else if (what == L"deny" && !exe.empty()) {
+        _throttle_policy.deny.insert(exe);
+    } else if (what == L"clear") {
+        _throttle_policy.allow.clear();
+        _throttle_policy.deny.clear();
+    } else {
+        log_debug(L"usage: :throttle on|off|trim|notrim|allow <exe>|deny <exe>|clear");
+        return false;
+    }
+    return true;
+}
+
+// :export [json|binary] [container=<name>] [monitor=<device>] [<file>]
+bool cmd_export(HWND hwnd, const cmd_t& cmd)
+{
+    export_format_t format = EXPORT_JSON;
+    export_filter_t filter;
+    wstring_view path;
+    for(const auto& arg: cmd.args) {
+        wstring_view a(arg);
+        if (a == L"json") {
+            format = EXPORT_JSON;
+        } else if (a == L"binary") {
+            format = EXPORT_BINARY;
+        } else if (a.substr(0, 10) == L"container=") {
+            filter.container = _strings.find(a.substr(10));
+            if (!filter.container) {
+                log_debug(L"no such container");
+                return false;
+            }
+        } else if (a.substr(0, 8) == L"monitor=") {
+            wstring_view device = a.substr(8);
+            for(const auto& it: _topology) {
+                if (it.second.device == device || it.second.path == device) {
+                    filter.monitor = it.first;
+                }
+            }
+            if (!filter.monitor) {
+                log_debug(L"no such monitor");
+                return false;
+            }
+        } else {
+            path = a;
+        }
+    }
+
+    FILE* f = nullptr;
+    if (!path.empty()) {
+        f = _wfopen(wstring(path).c_str(), format == EXPORT_JSON ? L"w" : L"wb");
+        if (!f) {
+            log_debug(L"can't open " + wstring(path));
+            return false;
+        }
+    }
+    const auto start = std::chrono::steady_clock::now();
+    size_t size;
+    {
+        export_writer_t out(format, f);
+        export_state(out, filter);
+        size = out.size();
+        if (!f && format == EXPORT_JSON) {
+            // JSON is UTF-8
+            log_debug(utf8_to_w(out.buffer()));
+        }
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if (f) {
+        fclose(f);
+    }
+    log_debug(L"exported " + _w(size) + L" bytes in " + _w(us) + L"us");
+    return false;
+}
+
+bool cmd_info(HWND hwnd, const cmd_t& cmd)
+{
+    {
+        rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+        if (snap) {
+            log_debug(L"snapshot #" + _w(snap->generation) + L" (applied #" + _w(_applied_generation) + L"): "
+                    + _w(snap->windows.size()) + L" windows (" + _w(snap->stale) + L" stale) on "
+                    + _w(snap->monitors.size()) + L" monitors in " + _w(snap->duration_ms) + L"ms using "
+                    + _w(harvest_pool().size()) + L" threads, " + _w(_snapshot.retired()) + L" retired, "
+                    + _w(hung_windows()) + L" hung windows skipped, " + _w(harvest_pool().refused())
+                    + L" harvest jobs refused");
+            for(const auto& it: snap->monitors) {
+                log_debug(it.second.tostr());
+            }
+        }
+    }
+    for(const auto& it: _topology) {
+        wstring txt(L"placing on HMONITOR=");
         txt.append(_w(it.first));
-        txt.append(L" is now on HMONITOR=");
-        txt.append(_w(MonitorFromWindow(it.second, MONITOR_DEFAULTTONULL)));
+        txt.append(L" ");
+        txt.append(it.second.path.empty() ? it.second.device : it.second.path);
+        txt.append(L" ");
+        txt.append(_w(it.second.rect));
+        txt.append(L" at ");
+        txt.append(_w(it.second.dpi));
+        txt.append(L"dpi");
         log_debug(txt);
     }
     for(const auto& it: _monitors)
@@ -765,55 +1028,131 @@ bool cmd_info(HWND hwnd, const cmd_t cmd)
         monitor_t m = get_monitor_info(it.first);
         log_debug(m.tostr());
     }
-    for(const auto& it: _containers)
+    vector<const container_map_t::value_type*> sorted;
+    containers_by_name(sorted);
+    for(const auto* it: sorted)
     {
-        log_debug(it.second->tostr());
+        log_debug(it->second->tostr());
+    }
+    log_debug(L"last switch: " + _w(_layout_last.shown) + L" shown, " + _w(_layout_last.hidden) + L" hidden, "
+            + _w(_layout_last.moved) + L" moved, " + _w(_layout_last.skipped) + L" skipped (in total "
+            + _w(_layout_total.shown + _layout_total.hidden + _layout_total.moved) + L" window operations, "
+            + _w(_layout_total.skipped) + L" skipped)");
+    log_debug(L"last switch took " + _w(_last_switch_us) + L"us, first input "
+            + _w(_first_input.last_ms) + L"ms after it (" + _w(_first_input.count ? _first_input.total_ms / _first_input.count : 0.0)
+            + L"ms on average, focus kept in " + _w(_first_input.focus_kept) + L" of " + _w(_first_input.count) + L" switches)");
+    for(int i = 0; i < HIDE_STRATEGIES; ++i) {
+        const hide_stats_t& st = _hide_stats[i];
+        log_debug(wstring(hide_strategy_name(static_cast<hide_strategy_t>(i))) + L": " + _w(st.calls)
+                + L" windows hidden or shown, " + _w(st.calls ? st.total_us / st.calls : 0.0) + L"us on average, "
+                + _w(st.max_us) + L"us max");
+    }
+    log_debug(wstring(L"throttling ") + (_throttle_policy.enabled ? L"on" : L"off")
+            + (_throttle_policy.trim ? L" with" : L" without") + L" trimming: "
+            + _w(throttled_processes()) + L" processes throttled now, " + _w(_throttle_stats.throttled) + L" throttled, "
+            + _w(_throttle_stats.restored) + L" restored, " + _w(_throttle_stats.failed) + L" failed, "
+            + _w(_throttle_stats.trimmed_bytes / 1024) + L"KB trimmed, "
+            + _w(_throttle_stats.throttled_cpu_us / 1000) + L"ms CPU used in "
+            + _w(_throttle_stats.throttled_us / 1000000) + L"s spent throttled");
+    log_debug(L"history: version " + _w(history_position() + 1) + L" of " + _w(history_size()) + L" using "
+            + _w(history_bytes() / 1024) + L"KB, " + _w(_history_stats.shared) + L" container records shared, "
+            + _w(_history_stats.copied) + L" copied, last restore took " + _w(_history_stats.last_restore_us) + L"us");
+    log_debug(L"config: " + _config_path.wstring() + (_config_stats.from_cache ? L" from its cache, mapped in " : L" parsed, mapped in ")
+            + _w(_config_stats.map_us) + L"us, decoded in " + _w(_config_stats.decode_us) + L"us, parsed in "
+            + _w(_config_stats.parse_us) + L"us, swapped in " + _w(_config_stats.swap_us) + L"us, "
+            + _w(_config_stats.errors.size()) + L" errors");
+    log_debug(wstring(L"input: ") + (_input_hooked ? L"keyboard hook, " : L"registered hotkeys, ") + _w(_input_stats.dispatched)
+            + L" dispatched (" + _w(_input_stats.sequences) + L" sequences), " + _w(_input_dropped.load()) + L" dropped, "
+            + _w(_input_stats.unbound) + L" unbound, latency p50 " + _w(_input_stats.percentile(0.5)) + L"us, p99 "
+            + _w(_input_stats.percentile(0.99)) + L"us, max " + _w(_input_stats.max_us) + L"us");
+    const cmdlog_stats_t& cl = _command_log.stats();
+    log_debug(L"command log: " + _w(_command_log.size()) + L" entries, " + _w(cl.file_bytes) + L" bytes, " + _w(cl.loaded)
+            + L" loaded in " + _w(cl.load_us) + L"us, " + _w(cl.compactions) + L" compactions dropped " + _w(cl.dropped)
+            + L", the last took " + _w(cl.last_compaction_us) + L"us, last search " + _w(cl.last_search_us) + L"us");
+    log_debug(L"tasks: " + _w(running_tasks()) + L" running, " + _w(_task_stats.started) + L" started, "
+            + _w(_task_stats.completed) + L" completed, " + _w(_task_stats.cancelled) + L" cancelled, "
+            + _w(_task_stats.resumed) + L" steps");
+    for(const auto& job: idle_jobs()) {
+        const idle_stats_t& st = job.stats;
+        log_debug(L"idle " + job.name + L": " + _w(st.runs) + L" runs in " + _w(st.steps) + L" steps, "
+                + _w(st.deferrals) + L" deferred for input, " + _w(st.sliced) + L" out of time, " + _w(st.overruns)
+                + L" steps over the " + _w(job.slice_us) + L"us slice, last run " + _w(st.last_us) + L"us, longest step "
+                + _w(st.max_step_us) + L"us, " + _w(st.total_us) + L"us in total");
+    }
+    log_debug(L"interned strings: " + _w(_strings.size()) + L" (" + _w(_strings.bytes()) + L" bytes)");
+    log_debug(L"event arena: " + _w(_arena.capacity()) + L" bytes, " + _w(_arena.events()) + L" events, "
+            + _w(_arena.last_allocations()) + L" heap allocations during the last one");
+    log_debug(L"heap: " + _w(heap_allocations()) + L" allocations, " + _w(heap_live_bytes()) + L" bytes live, allocation tracking "
+            + (alloc_tracking() ? L"on" : L"off (:alloc on)"));
+    for(const auto& st: alloc_stats()) {
+        if (!st.calls) {
+            continue;
+        }
+        log_debug(s2w(st.name) + L": " + _w(st.calls) + L" calls, " + _w(static_cast<double>(st.allocations) / st.calls)
+                + L" allocations (" + _w(st.bytes / st.calls) + L" bytes) per call, at most " + _w(st.max_allocations));
     }
     return false;
 }
 
-const map<wstring, cmd_spec_t> _commands = {
-    {L":show_main_window", {{true, {MOD_CONTROL | MOD_NOREPEAT, VK_UP}}, cmd_show_main_window}},
-    {L":quit", {{false, {}}, cmd_quit_program}},
-    {L":new", {{false, {}}, cmd_new_desktop}},
-    {L":switch", {{false, {}}, cmd_switch_to_desktop}},
-    {L":rename", {{false, {}}, cmd_rename_current_container}},
-    {L":scan", {{false, {}}, cmd_scan_desktops}},
-    {L":kill", {{false, {}}, cmd_kill_windows}},
-    {L":release", {{false, {}}, cmd_delete_desktop}},
-    {L":info", {{false, {}}, cmd_info}},
+// transparent compare, so lookups by view don't need a temporary key
+const map<wstring, cmd_spec_t, std::less<>> _commands = {
+    {L":show_main_window", {cmd_show_main_window}},
+    {L":quit", {cmd_quit_program}},
+    {L":new", {cmd_new_desktop}},
+    {L":switch", {nullptr, cmd_switch_to_desktop}},
+    {L":move", {nullptr, cmd_move_windows}},
+    {L":rename", {cmd_rename_current_container}},
+    {L":scan", {nullptr, cmd_scan_desktops}},
+    {L":kill", {nullptr, cmd_kill_windows}},
+    {L":release", {cmd_delete_desktop}},
+    {L":undo", {cmd_undo}},
+    {L":redo", {cmd_redo}},
+    {L":info", {cmd_info}},
+    {L":hide_with", {cmd_hide_with}},
+    {L":export", {cmd_export}},
+    {L":throttle", {cmd_throttle}},
+    {L":alloc", {cmd_alloc}},
+#ifndef NDEBUG
+    {L":stall", {cmd_stall}},
+#endif
 };
 
-cmd_t split_command(wstring scmd)
+static inline bool is_separator(wchar_t ch)
 {
-    trim(scmd);
-    cmd_t cmd;
-    if (scmd.empty()) {
-        return cmd;
-    }
-    std::wregex regex{LR"([\s,]+)"}; // split on space and comma
-    std::wsregex_token_iterator it{scmd.begin(), scmd.end(), regex, -1};
-    cmd.cmd = *it;
-    cmd.args = {++it, {}};
-    return cmd;
+    return std::iswspace(ch) || ch == L',';
 }
 
-bool update_preview(HWND hwnd, wstring scmd)
+cmd_t split_command(wstring_view scmd)
 {
-    cmd_t cmd = split_command(scmd);
-    clear_preview();
-    for(const auto& e: _containers) {
-        if (e.first.find(cmd.cmd) != wstring::npos) {
-            log_info(e.first);
+    trim(scmd);
+    cmd_t cmd(_arena.resource());
+    // split on space and comma
+    bool first = true;
+    size_t i = 0;
+    while (i < scmd.size()) {
+        size_t j = i;
+        while (j < scmd.size() && !is_separator(scmd[j])) {
+            ++j;
+        }
+        if (first) {
+            cmd.cmd.assign(scmd.substr(i, j - i));
+            first = false;
         } else {
-            for(const auto& w: e.second->wmap) {
-                wstring t = get_window_title(w.second.hwnd);
-                if (t.find(cmd.cmd) != wstring::npos) {
-                    log_info(e.first + L" - " + t);
-                }
-            }
+            cmd.args.emplace_back(scmd.substr(i, j - i));
+        }
+        i = j;
+        while (i < scmd.size() && is_separator(scmd[i])) {
+            ++i;
         }
     }
+    return cmd;
+}
+
+bool update_preview(HWND hwnd, wstring_view scmd)
+{
+    alloc_scope_t alloc("update_preview");
+    cmd_t cmd = split_command(scmd);
+    preview_containers(cmd.cmd);
     for(const auto& e: _commands) {
         if (e.first.find(cmd.cmd) != wstring::npos) {
             log_info(e.first);
@@ -822,23 +1161,69 @@ bool update_preview(HWND hwnd, wstring scmd)
     return false;
 }
 
-bool run_command(HWND hwnd, wstring scmd)
+// an alias in front of `scmd` replaced by its command line, false if
+// there's none
+static bool expand_alias(wstring_view scmd, std::pmr::wstring& out)
 {
+    rcu_cell_t<config_t>::read_t config(_config);
+    if (!config || config->aliases.empty()) {
+        return false;
+    }
+    trim(scmd);
+    size_t end = 0;
+    while (end < scmd.size() && !is_separator(scmd[end])) {
+        ++end;
+    }
+    const wstring_view name = scmd.substr(0, end);
+    const wstring_view command = config->resolve_alias(name);
+    if (command.data() == name.data()) {
+        return false;
+    }
+    out.assign(command);
+    out.append(scmd.substr(end));
+    return true;
+}
+
+bool run_command(HWND hwnd, wstring_view scmd)
+{
+    alloc_scope_t alloc("run_command");
+    arena_scope_t scope(_arena);
+    std::pmr::wstring expanded(_arena.resource());
+    if (expand_alias(scmd, expanded)) {
+        scmd = expanded;
+    }
     cmd_t cmd = split_command(scmd);
     if (cmd.cmd.empty()) {
         show_main_window(hwnd, false);
         return true;
     }
-    log_debug(scmd);
-    auto it = _commands.find(cmd.cmd);
-
+    trace_input(scmd);
+    log_debug(std::pmr::wstring(scmd, _arena.resource()).c_str());
+    auto it = _commands.find(wstring_view(cmd.cmd));
+
+    // a newer command supersedes the one still waiting
+    auto done = [hwnd](bool hide) {
+        if (hide) {
+            show_main_window(hwnd, false);
+        }
+    };
     bool hide = false;
     if (it == _commands.end()) {
         log_debug(L"command not found");
         if (!scmd.empty() && (scmd[0] != L':')) {
-            hide = switch_to_desktop(hwnd, scmd);
+            start_task("command", switch_and_measure(hwnd, wstring(scmd)), done);
+            schedule_tasks(hwnd);
         }
+    } else if (it->second.task) {
+        start_task("command", it->second.task(hwnd, cmd), done);
+        schedule_tasks(hwnd);
     } else {
+        // commands are plain ASCII
+        std::pmr::string name(_arena.resource());
+        for(wchar_t ch: cmd.cmd) {
+            name.push_back(static_cast<char>(ch));
+        }
+        alloc_scope_t cmd_alloc(name);
         hide = it->second.func(hwnd, cmd);
     }
     if (hide) {
@@ -849,23 +1234,204 @@ bool run_command(HWND hwnd, wstring scmd)
 }
 
 bool handle_hotkey(HWND hwnd, SHORT modifiers, SHORT keycode) {
-    for(const auto& cmd : _commands) {
-        if (!cmd.second.hotkey.first) {
+    wstring command;
+    {
+        rcu_cell_t<config_t>::read_t config(_config);
+        const wstring* c = config ? config->hotkey_command(modifiers, keycode) : nullptr;
+        if (!c) {
+            return false;
+        }
+        // the command may reload the configuration
+        command = *c;
+    }
+    return run_command(hwnd, command);
+}
+
+// registered hotkeys by (modifiers, key), with their ids
+static map<pair<UINT, UINT>, int> _hotkeys;
+static int _next_hotkey_id = 1;
+
+// registers the configured hotkeys, unless the hook catches them. only
+// the difference to what's registered changes, so the ones that stay never
+// stop working.
+void apply_hotkeys(HWND hwnd)
+{
+    map<pair<UINT, UINT>, int> wanted;
+    if (!_input_hooked) {
+        rcu_cell_t<config_t>::read_t config(_config);
+        if (config) {
+            for(const auto& hk: config->hotkeys) {
+                // sequences need the hook
+                if (hk.then) {
+                    continue;
+                }
+                wanted.emplace(pair<UINT, UINT>(hk.modifiers, hk.key), 0);
+            }
+        }
+    }
+    for(auto it = _hotkeys.begin(); it != _hotkeys.end();) {
+        if (wanted.count(it->first)) {
+            ++it;
+            continue;
+        }
+        UnregisterHotKey(hwnd, it->second);
+        it = _hotkeys.erase(it);
+    }
+    for(const auto& w: wanted) {
+        if (_hotkeys.count(w.first)) {
             continue;
         }
-        const hotkey_t& hk = cmd.second.hotkey.second;
-        SHORT mod = hk.modifier & ~MOD_NOREPEAT;
-        if ((mod == modifiers) && (hk.keycode == keycode)) {
-            return run_command(hwnd, cmd.first);
+        const int id = _next_hotkey_id++;
+        if (!RegisterHotKey(hwnd, id, w.first.first, w.first.second)) {
+            log_error((L"failed to register hotkey " + _w(w.first.first) + L"+" + _w(w.first.second)).c_str());
+            continue;
         }
+        _hotkeys.emplace(w.first, id);
     }
-    return false;
+}
+
+// runs the hotkeys the input thread queued
+void dispatch_input(HWND hwnd)
+{
+    // hotkeys queued from now on post again
+    _input_posted.store(false);
+    input_event_t ev;
+    while (_input_queue.pop(ev)) {
+        const uint64_t start = input_now_us();
+        wstring command;
+        {
+            rcu_cell_t<config_t>::read_t config(_config);
+            const wstring* c = config ? config->hotkey_command(ev.modifiers, ev.key, ev.then) : nullptr;
+            if (!c) {
+                ++_input_stats.unbound;
+                continue;
+            }
+            command = *c;
+        }
+        _input_stats.record(static_cast<double>(start - ev.time_us));
+        if (ev.then) {
+            ++_input_stats.sequences;
+        }
+        run_command(hwnd, command);
+    }
+}
+
+// applies a freshly published configuration
+void config_loaded(HWND hwnd, config_load_stats_t stats)
+{
+    for(const auto& e: stats.errors) {
+        log_debug(_config_path.wstring() + L": " + e);
+    }
+    _config_stats = std::move(stats);
+    apply_hotkeys(hwnd);
+    {
+        rcu_cell_t<config_t>::read_t config(_config);
+        _input_height = config->input_height;
+    }
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    SendMessage(hwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(rc.right - rc.left, rc.bottom - rc.top));
+    // ignore rules apply from the next snapshot on
+    _scanner.request();
+}
+
+// shows `text` in the input box with [from, to) selected
+static void set_input(HWND hwnd, wstring_view text, size_t from, size_t to)
+{
+    SetWindowText(hwnd, wstring(text).c_str());
+    SendMessage(hwnd, EM_SETSEL, from, to);
+}
+
+static void start_walking(HWND hwnd)
+{
+    if (_recall.walking) {
+        return;
+    }
+    _recall.walking = true;
+    _recall.at = _command_log.size();
+    arena_scope_t scope(_arena);
+    _recall.draft = get_edit_text(hwnd, _arena.resource());
+}
+
+// up (older > 0) and down through the log
+static void recall_step(HWND hwnd, int older)
+{
+    start_walking(hwnd);
+    _recall.searching = false;
+    if (older > 0 && _recall.at == 0) {
+        return;
+    }
+    if (older < 0 && _recall.at >= _command_log.size()) {
+        return;
+    }
+    _recall.at = older > 0 ? _recall.at - 1 : _recall.at + 1;
+    wstring_view text = _recall.at < _command_log.size() ? _command_log.at(_recall.at) : wstring_view(_recall.draft);
+    set_input(hwnd, text, text.size(), text.size());
+}
+
+// shows the newest entry before `before` containing the needle, selected
+static void search_from(HWND hwnd, size_t before)
+{
+    const size_t found = _command_log.search(_recall.needle, before);
+    if (found == _command_log.size()) {
+        // nothing (else), show what's searched for
+        if (before == _command_log.size()) {
+            set_input(hwnd, _recall.needle, _recall.needle.size(), _recall.needle.size());
+        }
+        return;
+    }
+    _recall.at = found;
+    wstring_view text = _command_log.at(found);
+    const size_t pos = text.find(_recall.needle);
+    set_input(hwnd, text, pos, pos + _recall.needle.size());
+}
+
+// CTRL+R searches for what's typed, again for older matches
+static void search_step(HWND hwnd)
+{
+    start_walking(hwnd);
+    if (!_recall.searching) {
+        _recall.searching = true;
+        _recall.needle = _recall.draft;
+        search_from(hwnd, _command_log.size());
+        return;
+    }
+    search_from(hwnd, _recall.at);
+}
+
+// typing while searching changes what's searched for, the current match
+// stays if it still matches
+static bool search_char(HWND hwnd, wchar_t ch)
+{
+    if (ch == L'\b') {
+        if (!_recall.needle.empty()) {
+            _recall.needle.pop_back();
+        }
+    } else if (ch >= L' ') {
+        _recall.needle.push_back(ch);
+    } else {
+        return false;
+    }
+    const size_t at = _recall.at < _command_log.size() ? _recall.at + 1 : _command_log.size();
+    search_from(hwnd, ch == L'\b' ? _command_log.size() : at);
+    return true;
 }
 
 LRESULT CALLBACK myInputEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     switch (msg)
     {
+        case WM_KEYDOWN:
+            if (wParam == VK_UP || wParam == VK_DOWN) {
+                recall_step(hwnd, wParam == VK_UP ? 1 : -1);
+                return 0;
+            }
+            if (wParam == VK_LEFT || wParam == VK_RIGHT || wParam == VK_HOME || wParam == VK_END || wParam == VK_DELETE) {
+                // editing the match
+                _recall.searching = false;
+            }
+            return CallWindowProc(defaultInputEditProc, hwnd, msg, wParam, lParam);
+
         case WM_CHAR:
             {
                 if (wParam == 1) {
@@ -873,6 +1439,20 @@ LRESULT CALLBACK myInputEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
                     SendMessage(hwnd, EM_SETSEL, 0, -1);
                     return 0;
                 }
+                if (wParam == 0x12) {
+                    // CTRL+R
+                    search_step(hwnd);
+                    return 0;
+                }
+                if (wParam == VK_ESCAPE && _recall.searching) {
+                    // keeps the match
+                    _recall.searching = false;
+                    SendMessage(hwnd, EM_SETSEL, GetWindowTextLength(hwnd), GetWindowTextLength(hwnd));
+                    return 0;
+                }
+                if (_recall.searching && wParam != VK_RETURN && search_char(hwnd, static_cast<wchar_t>(wParam))) {
+                    return 0;
+                }
 
                 DWORD cmd = 0;
                 if (wParam == VK_ESCAPE) {
@@ -951,10 +1531,10 @@ LRESULT CALLBACK WindowProc(
                 WORD w = LOWORD(lParam);
                 WORD whalf = w/2;
                 WORD wrest = w - whalf - 1;
-                WORD hrest = HIWORD(lParam) - INPUTHEIGHT;
-                MoveWindow(hwndInput, 0, 0, w, INPUTHEIGHT, TRUE);
-                MoveWindow(hwndPreview, 0, INPUTHEIGHT, whalf, hrest, TRUE);
-                MoveWindow(hwndLog, whalf+1, INPUTHEIGHT, wrest, hrest, TRUE);
+                WORD hrest = HIWORD(lParam) - _input_height;
+                MoveWindow(hwndInput, 0, 0, w, _input_height, TRUE);
+                MoveWindow(hwndPreview, 0, _input_height, whalf, hrest, TRUE);
+                MoveWindow(hwndLog, whalf+1, _input_height, wrest, hrest, TRUE);
             }
             return 0;
 
@@ -964,14 +1544,49 @@ LRESULT CALLBACK WindowProc(
             }
             break;
 
-        // case WM_DISPLAYCHANGE:
-        //     {
-        //         DWORD depth = wParam;
-        //         WORD w = LOWORD(lParam);
-        //         WORD h = HIWORD(lParam);
-        //         log_debug(wstring(L"WM_DISPLAYCHANGE ") + _w(depth) + L"(" + _w(w) + L"," + _w(h) + L")");
-        //     }
-        //     break;
+        case WM_TIMER:
+            if (wParam == ID_TIMER_TASKS) {
+                {
+                    arena_scope_t scope(_arena);
+                    run_tasks();
+                }
+                schedule_tasks(hwnd);
+                return 0;
+            }
+            break;
+
+        case WM_USER_SNAPSHOT:
+            apply_latest_snapshot();
+            snapshot_applied();
+            schedule_tasks(hwnd);
+            return 0;
+
+        case WM_USER_INPUT:
+            dispatch_input(hwnd);
+            return 0;
+
+        case WM_USER_CMDLOG:
+            // entry indices changed
+            _command_log.finish_compaction();
+            reset_recall();
+            return 0;
+
+        case WM_USER_CONFIG:
+            {
+                unique_ptr<config_load_stats_t> stats(reinterpret_cast<config_load_stats_t*>(lParam));
+                config_loaded(hwnd, std::move(*stats));
+            }
+            return 0;
+
+        case WM_DISPLAYCHANGE:
+            {
+                DWORD depth = static_cast<DWORD>(wParam);
+                WORD w = LOWORD(lParam);
+                WORD h = HIWORD(lParam);
+                log_debug(wstring(L"WM_DISPLAYCHANGE ") + _w(depth) + L"(" + _w(w) + L"," + _w(h) + L")");
+                display_changed();
+            }
+            break;
 
         case WM_COMMAND:
             if (LOWORD(wParam) != ID_EDITINPUT) {
@@ -979,7 +1594,10 @@ LRESULT CALLBACK WindowProc(
             }
             switch HIWORD(wParam) {
                 case EN_CHANGE:
-                    update_preview(hwnd, get_edit_text(reinterpret_cast<HWND>(lParam)));
+                    {
+                        arena_scope_t scope(_arena);
+                        update_preview(hwnd, get_edit_text(reinterpret_cast<HWND>(lParam), _arena.resource()));
+                    }
                     return 0;
 
                 case EN_USER_ABORT:
@@ -987,7 +1605,13 @@ LRESULT CALLBACK WindowProc(
                     return 0;
 
                 case EN_USER_CONFIRM:
-                    run_command(hwnd, get_edit_text(reinterpret_cast<HWND>(lParam)));
+                    {
+                        arena_scope_t scope(_arena);
+                        std::pmr::wstring text = get_edit_text(reinterpret_cast<HWND>(lParam), _arena.resource());
+                        _command_log.append(text);
+                        reset_recall();
+                        run_command(hwnd, text);
+                    }
                     return 0;
             }
             return 0;
@@ -1042,8 +1666,138 @@ LRESULT CALLBACK WindowProc(
 //     return 0;
 // }
 
+// runs on the input thread for every key. it has to be quick, windows
+// skips hooks that take longer than LowLevelHooksTimeout.
+LRESULT CALLBACK keyboard_hook(int code, WPARAM wParam, LPARAM lParam)
+{
+    const KBDLLHOOKSTRUCT* k = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lParam);
+    if (code != HC_ACTION || (k->flags & LLKHF_INJECTED)) {
+        return CallNextHookEx(NULL, code, wParam, lParam);
+    }
+    const bool down = wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN;
+    input_event_t ev;
+    input_action_t action = INPUT_PASS;
+    {
+        rcu_cell_t<config_t>::read_t config(_config);
+        if (config) {
+            action = _input_matcher.key(*config, k->vkCode, down, input_now_us(), ev);
+        }
+    }
+    if (action == INPUT_PASS) {
+        return CallNextHookEx(NULL, code, wParam, lParam);
+    }
+    if (action == INPUT_DISPATCH) {
+        if (!_input_queue.push(ev)) {
+            ++_input_dropped;
+        } else if (!_input_posted.exchange(true)) {
+            PostMessage(hwndMain, WM_USER_INPUT, 0, 0);
+        }
+    }
+    // the windows key going up without another key in between opens the
+    // start menu, and the swallowed key doesn't count
+    if (_input_matcher.modifiers() & CONFIG_MOD_WIN) {
+        keybd_event(VK_MASK, 0, 0, 0);
+        keybd_event(VK_MASK, 0, KEYEVENTF_KEYUP, 0);
+    }
+    return 1;
+}
+
+// installs the keyboard hook and runs its message loop until WM_QUIT,
+// above the priority of everything else so hotkeys never wait
+void input_thread(HANDLE ready)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    MSG msg;
+    // the message queue, for PostThreadMessage()
+    PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+    _input_thread_id = GetCurrentThreadId();
+    HHOOK hook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboard_hook, GetModuleHandle(NULL), 0);
+    _input_hooked = hook != NULL;
+    SetEvent(ready);
+    if (!hook) {
+        return;
+    }
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+    }
+    UnhookWindowsHookEx(hook);
+}
+
+// the value of `opt` on the command line: quoted, or up to the next option
+string option_value(LPSTR lpszCmdLine, const string& opt)
+{
+    string args = lpszCmdLine ? lpszCmdLine : "";
+    size_t pos = args.find(opt + " ");
+    if (pos == string::npos) {
+        return string();
+    }
+    string value = args.substr(pos + opt.size() + 1);
+    value.erase(0, value.find_first_not_of(' '));
+    if (!value.empty() && value[0] == '"') {
+        return value.substr(1, value.find('"', 1) - 1);
+    }
+    value.erase(std::min(value.size(), value.find(" --")));
+    value.erase(value.find_last_not_of(' ') + 1);
+    return value;
+}
+
+// `--trace <file>` records all window system calls into <file>
+string trace_path(LPSTR lpszCmdLine)
+{
+    return option_value(lpszCmdLine, "--trace");
+}
+
+// `--config <file>`, otherwise ttwwam.conf in %APPDATA%
+std::filesystem::path config_path(LPSTR lpszCmdLine)
+{
+    string path = option_value(lpszCmdLine, "--config");
+    if (!path.empty()) {
+        return std::filesystem::path(s2w(path));
+    }
+    const wchar_t* appdata = _wgetenv(L"APPDATA");
+    return std::filesystem::path(appdata ? appdata : L".") / L"ttwwam.conf";
+}
+
+// the size and modification time, to tell edits from the cache being written
+static pair<uintmax_t, std::filesystem::file_time_type> config_stamp(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    return {std::filesystem::file_size(path, ec), std::filesystem::last_write_time(path, ec)};
+}
+
+// reloads the configuration whenever its directory changes until `quit` is
+// signaled. the main window gets the stats and applies what isn't read
+// from _config directly.
+void watch_config(HANDLE quit)
+{
+    HANDLE change = FindFirstChangeNotification(_config_path.parent_path().wstring().c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (change == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    auto stamp = config_stamp(_config_path);
+    HANDLE handles[] = {quit, change};
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        // editors save in several steps
+        Sleep(CONFIG_SETTLE_MS);
+        FindNextChangeNotification(change);
+        auto now = config_stamp(_config_path);
+        if (now == stamp) {
+            continue;
+        }
+        stamp = now;
+        unique_ptr<config_load_stats_t> stats(new config_load_stats_t());
+        reload_config(_config_path, *stats);
+        PostMessage(hwndMain, WM_USER_CONFIG, 0, reinterpret_cast<LPARAM>(stats.release()));
+    }
+    FindCloseChangeNotification(change);
+}
+
 LIBTTWWAM_EXPORT int CALLBACK ttwwam_main(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpszCmdLine, int nCmdShow)
 {
+    // physical pixels everywhere, so geometry relative to a monitor stays
+    // valid when its scaling changes
+    SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+
     WNDCLASSEX wce = {
         sizeof(wce),
         0,
@@ -1080,20 +1834,62 @@ LIBTTWWAM_EXPORT int CALLBACK ttwwam_main(HINSTANCE hInstance, HINSTANCE hPrevIn
     }
     log_debug(L"main window created");
 
-
-    for(const auto& c : _commands) {
-        const cmd_spec_t& cmd = c.second;
-        if (!cmd.hotkey.first) {
-            continue;
-        }
-        const hotkey_t& hk = cmd.hotkey.second;
-        if (!RegisterHotKey(hwndMain, 1, hk.modifier, hk.keycode)) {
-            wstring err = L"Failed to register hotkey for ";
-            err += c.first + L": " + get_last_error_message();
-            MessageBox(hwndMain, err.c_str(), L"", MB_OK);
-            return -3;
+    winsys_t* ws = &_win32;
+    string path = trace_path(lpszCmdLine);
+    if (!path.empty()) {
+        _trace_writer = trace_writer_t::open(path);
+        if (_trace_writer) {
+            _recorder.reset(new recording_winsys_t(_win32, *_trace_writer));
+            ws = _recorder.get();
+            core_trace(_trace_writer.get());
+            log_debug(L"recording trace to " + s2w(path));
+        } else {
+            log_debug(L"failed to open trace file " + s2w(path));
         }
     }
+    core_init(ws, hwndMain);
+
+    // for status bars, see status.h
+    HANDLE status_mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            0, sizeof(status_segment_t), STATUS_SEGMENT_NAME);
+    void* status_view = status_mapping ? MapViewOfFile(status_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(status_segment_t)) : NULL;
+    if (status_view) {
+        status_attach(new (status_view) status_segment_t());
+    } else {
+        log_debug(L"failed to map the status segment: " + get_last_error_message());
+    }
+
+    _scanner.start([] {
+        PostMessage(hwndMain, WM_USER_SNAPSHOT, 0, 0);
+    });
+
+
+    HANDLE input_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+    std::thread input(input_thread, input_ready);
+    WaitForSingleObject(input_ready, INFINITE);
+    CloseHandle(input_ready);
+    if (!_input_hooked) {
+        log_error(L"failed to install the keyboard hook, falling back to registered hotkeys");
+    }
+
+    _config_path = config_path(lpszCmdLine);
+    {
+        config_load_stats_t stats;
+        reload_config(_config_path, stats);
+        config_loaded(hwndMain, std::move(stats));
+    }
+    _command_log.open(_config_path.parent_path() / L"ttwwam.history", [] {
+        PostMessage(hwndMain, WM_USER_CMDLOG, 0, 0);
+    });
+    // the copy compaction takes is too big for the path of running a command
+    add_idle_job(L"command_log", 3, 10000, 5000, [] {
+        if (_command_log.compaction_due()) {
+            _command_log.compact();
+        }
+        return IDLE_DONE;
+    });
+    HANDLE config_quit = CreateEvent(NULL, TRUE, FALSE, NULL);
+    std::thread config_watcher(watch_config, config_quit);
 
     // HINSTANCE hi = reinterpret_cast<HINSTANCE>(GetWindowLongPtr(hwndMain, GWLP_HINSTANCE));
     // HMODULE hm = GetModuleHandle(L"libttwwam");
@@ -1107,23 +1903,53 @@ LIBTTWWAM_EXPORT int CALLBACK ttwwam_main(HINSTANCE hInstance, HINSTANCE hPrevIn
     //     return -4;
     // }
 
-    BOOL ok;
+    // messages first, the housekeeping jobs (see idle.h) only get the time
+    // the queue is empty and give it back as soon as something arrives
     MSG msg = {0};
-    while((ok = GetMessage(&msg, NULL, 0, 0)) != 0)
-    {
-        if (ok == -1) {
-            // idk, maybe exit?
-            // log_error(L"exit?");
-            break;
-        } else {
+    for(;;) {
+        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                break;
+            }
             TranslateMessage(&msg);
             DispatchMessage(&msg);
+            continue;
         }
+        const int idle_ms = next_idle_ms();
+        if (idle_ms == 0) {
+            run_idle(input_pending);
+            continue;
+        }
+        // until a message arrives or the next job is due
+        MsgWaitForMultipleObjectsEx(0, NULL, idle_ms < 0 ? INFINITE : static_cast<DWORD>(idle_ms), QS_ALLINPUT,
+                MWMO_INPUTAVAILABLE);
+    }
+
+    SetEvent(config_quit);
+    config_watcher.join();
+    CloseHandle(config_quit);
+    PostThreadMessage(_input_thread_id, WM_QUIT, 0, 0);
+    input.join();
+
+    _scanner.stop();
+    cancel_tasks();
+    _command_log.close();
+
+    status_attach(nullptr);
+    if (status_view) {
+        UnmapViewOfFile(status_view);
+    }
+    if (status_mapping) {
+        CloseHandle(status_mapping);
     }
 
     for(const auto& c : _containers) {
         show_hide_container(c.second, true);
     }
+    restore_all_processes();
+
+    core_trace(nullptr);
+    _trace_writer.reset();
 
     return static_cast<int>(msg.wParam);
 }
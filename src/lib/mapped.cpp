@@ -0,0 +1,66 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped.h"
+
+mapped_file_t::mapped_file_t(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || !size.QuadPart) {
+        return;
+    }
+    _mapping = CreateFileMappingW(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!_mapping) {
+        return;
+    }
+    _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    _size = _data ? static_cast<size_t>(size.QuadPart) : 0;
+#else
+    _fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (_fd < 0 || fstat(_fd, &st) || !st.st_size) {
+        return;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (p != MAP_FAILED) {
+        _data = static_cast<const uint8_t*>(p);
+        _size = static_cast<size_t>(st.st_size);
+    }
+#endif
+}
+
+mapped_file_t::~mapped_file_t()
+{
+#ifdef _WIN32
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+#else
+    if (_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+#endif
+}
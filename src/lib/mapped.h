@@ -0,0 +1,32 @@
+#ifndef _LIBTTWWAM_MAPPED_H_
+#define _LIBTTWWAM_MAPPED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// read only view of a whole file, empty if it's missing or empty
+class mapped_file_t {
+public:
+    explicit mapped_file_t(const std::filesystem::path& path);
+    ~mapped_file_t();
+
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+#ifdef _WIN32
+    // HANDLEs
+    void* _file;
+    void* _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+};
+
+#endif // _LIBTTWWAM_MAPPED_H_
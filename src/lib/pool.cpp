@@ -0,0 +1,71 @@
+#include "pool.h"
+
+worker_pool_t::worker_pool_t(size_t threads, size_t max_jobs)
+    : _max_jobs(max_jobs)
+{
+    if (!threads) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (!threads) {
+        threads = 2;
+    }
+    _threads.reserve(threads);
+    for(size_t i = 0; i < threads; ++i) {
+        _threads.emplace_back(&worker_pool_t::run, this);
+    }
+}
+
+worker_pool_t::~worker_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cv.notify_all();
+    for(auto& t: _threads) {
+        t.join();
+    }
+}
+
+bool worker_pool_t::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_jobs.size() >= _max_jobs) {
+            ++_refused;
+            return false;
+        }
+        _jobs.push_back(std::move(job));
+    }
+    _cv.notify_one();
+    return true;
+}
+
+size_t worker_pool_t::queued()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _jobs.size();
+}
+
+size_t worker_pool_t::refused()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _refused;
+}
+
+void worker_pool_t::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(;;) {
+        _cv.wait(lock, [this] { return _quit || !_jobs.empty(); });
+        if (_jobs.empty()) {
+            // quitting and nothing left to do
+            return;
+        }
+        std::function<void()> job = std::move(_jobs.front());
+        _jobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
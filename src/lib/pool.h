@@ -0,0 +1,42 @@
+#ifndef _LIBTTWWAM_POOL_H_
+#define _LIBTTWWAM_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed number of threads working off a shared job queue. the queue holds
+// at most `max_jobs`, threads stuck in a job don't let it grow without bound.
+class worker_pool_t {
+public:
+    // 0 means one thread per core
+    explicit worker_pool_t(size_t threads = 0, size_t max_jobs = 64);
+    ~worker_pool_t();
+
+    worker_pool_t(const worker_pool_t&) = delete;
+    worker_pool_t& operator=(const worker_pool_t&) = delete;
+
+    // false (and the job dropped) if the queue is full
+    bool submit(std::function<void()> job);
+    size_t size() const { return _threads.size(); }
+    size_t queued();
+    // jobs refused so far
+    size_t refused();
+
+private:
+    void run();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _jobs;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    size_t _max_jobs;
+    size_t _refused = 0;
+    bool _quit = false;
+};
+
+#endif // _LIBTTWWAM_POOL_H_
@@ -0,0 +1,166 @@
+#ifndef _LIBTTWWAM_RCU_H_
+#define _LIBTTWWAM_RCU_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a published, immutable value that is replaced as a whole (RCU style)
+//
+// readers pin the current value with a hazard slot and never block, neither
+// on each other nor on writers. writers are serialized, swap in the new
+// value and free every retired value no reader has pinned anymore. at most
+// READERS values can be pinned at a time, so there are never more than
+// READERS + 2 values alive.
+//
+// READERS is also the limit on concurrent readers: one more waits for a
+// slot, spinning briefly and then yielding its time slice. size it for the
+// threads that read the cell, and never hold two reads of the same cell on
+// one thread, with all slots taken that waits forever.
+template<typename T, size_t READERS = 4>
+class rcu_cell_t {
+public:
+    class read_t {
+    public:
+        explicit read_t(const rcu_cell_t& cell)
+            : _cell(cell), _slot(cell.claim())
+        {
+            std::atomic<const T*>& hazard = _cell._hazards[_slot];
+            const T* p = _cell._current.load();
+            for(;;) {
+                hazard.store(p);
+                const T* q = _cell._current.load();
+                if (p == q) {
+                    break;
+                }
+                p = q;
+            }
+            _value = p;
+        }
+
+        ~read_t()
+        {
+            _cell._hazards[_slot].store(nullptr, std::memory_order_release);
+            _cell._claimed[_slot].store(false, std::memory_order_release);
+        }
+
+        read_t(const read_t&) = delete;
+        read_t& operator=(const read_t&) = delete;
+
+        const T* get() const { return _value; }
+        const T* operator->() const { return _value; }
+        const T& operator*() const { return *_value; }
+        explicit operator bool() const { return _value != nullptr; }
+
+    private:
+        const rcu_cell_t& _cell;
+        size_t _slot;
+        const T* _value;
+    };
+
+    rcu_cell_t()
+        : _current(nullptr)
+    {
+        for(size_t i = 0; i < READERS; ++i) {
+            _hazards[i].store(nullptr);
+            _claimed[i].store(false);
+        }
+        _retired.reserve(READERS + 1);
+    }
+
+    ~rcu_cell_t()
+    {
+        delete _current.load();
+        for(const T* p: _retired) {
+            delete p;
+        }
+    }
+
+    rcu_cell_t(const rcu_cell_t&) = delete;
+    rcu_cell_t& operator=(const rcu_cell_t&) = delete;
+
+    void publish(std::unique_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        const T* old = _current.exchange(value.release());
+        if (old) {
+            _retired.push_back(old);
+        }
+        reclaim();
+    }
+
+    // publishes `value` only if `replaces(current, value)`, checked under
+    // the writer lock so concurrent writers can't overtake each other.
+    // `current` may be null. returns whether it was published.
+    template<typename F>
+    bool publish_if(std::unique_ptr<T> value, F replaces)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        if (!replaces(_current.load(), *value)) {
+            return false;
+        }
+        const T* old = _current.exchange(value.release());
+        if (old) {
+            _retired.push_back(old);
+        }
+        reclaim();
+        return true;
+    }
+
+    // values waiting for their readers to go away
+    size_t retired() const
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        return _retired.size();
+    }
+
+private:
+    size_t claim() const
+    {
+        // slots are held for a copy or a lookup, a few passes usually do
+        const unsigned SPINS = 64;
+        for(unsigned pass = 0;; ++pass) {
+            for(size_t i = 0; i < READERS; ++i) {
+                if (!_claimed[i].load(std::memory_order_relaxed)
+                        && !_claimed[i].exchange(true, std::memory_order_acquire)) {
+                    return i;
+                }
+            }
+            if (pass >= SPINS) {
+                // the holders might be waiting for this core
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void reclaim()
+    {
+        for(size_t i = 0; i < _retired.size();) {
+            bool pinned = false;
+            for(size_t h = 0; h < READERS; ++h) {
+                if (_hazards[h].load() == _retired[i]) {
+                    pinned = true;
+                    break;
+                }
+            }
+            if (pinned) {
+                ++i;
+            } else {
+                delete _retired[i];
+                _retired[i] = _retired.back();
+                _retired.pop_back();
+            }
+        }
+    }
+
+    std::atomic<const T*> _current;
+    mutable std::atomic<const T*> _hazards[READERS];
+    mutable std::atomic<bool> _claimed[READERS];
+    mutable std::mutex _writer;
+    std::vector<const T*> _retired;
+};
+
+#endif // _LIBTTWWAM_RCU_H_
@@ -0,0 +1,56 @@
+#ifndef _LIBTTWWAM_SPSC_H_
+#define _LIBTTWWAM_SPSC_H_
+
+#include <atomic>
+#include <cstddef>
+
+// a bounded queue between exactly one producer and one consumer thread
+//
+// neither side ever blocks or takes a lock: the producer only writes
+// `_tail`, the consumer only `_head`, each reads the other's index to see
+// how far it may go. SIZE has to be a power of two, one slot stays empty
+// to tell full from empty.
+template<typename T, size_t SIZE>
+class spsc_queue_t {
+    static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SIZE has to be a power of two");
+
+public:
+    // producer side, false if the queue is full
+    bool push(const T& value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) & (SIZE - 1);
+        if (next == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _slots[tail] = value;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false if the queue is empty
+    bool pop(T& out)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = _slots[head];
+        _head.store((head + 1) & (SIZE - 1), std::memory_order_release);
+        return true;
+    }
+
+    // either side, only a hint while the other one is running
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // apart, so the two sides don't share a cache line
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) T _slots[SIZE];
+};
+
+#endif // _LIBTTWWAM_SPSC_H_
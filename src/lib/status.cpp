@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cstring>
+
+#include "core.h"
+#include "status.h"
+
+static status_segment_t* _segment = nullptr;
+// staged here, then copied into the segment word by word
+static status_payload_t _payload;
+static uint64_t _changes = 0;
+
+void status_attach(status_segment_t* segment)
+{
+    _segment = segment;
+    publish_status();
+}
+
+// UTF-16 on windows, anything outside the BMP gets mangled elsewhere
+static void copy_name(char16_t* out, size_t size, std::wstring_view name)
+{
+    const size_t n = std::min(name.size(), size - 1);
+    for(size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<char16_t>(name[i]);
+    }
+    std::fill(out + n, out + size, u'\0');
+}
+
+void publish_status()
+{
+    if (!_segment) {
+        return;
+    }
+    status_payload_t& p = _payload;
+    std::memset(&p, 0, sizeof(p));
+    p.magic = STATUS_MAGIC;
+    p.version = STATUS_VERSION;
+    p.changes = ++_changes;
+
+    static std::vector<const container_map_t::value_type*> sorted;
+    containers_by_name(sorted);
+    for(const auto* it: sorted) {
+        if (p.containers == STATUS_CONTAINERS) {
+            break;
+        }
+        copy_name(p.container[p.containers++], STATUS_NAME, _strings.str(it->first));
+    }
+    for(const auto& it: _monitors) {
+        if (p.monitors == STATUS_MONITORS) {
+            break;
+        }
+        status_monitor_t& m = p.monitor[p.monitors++];
+        m.container = -1;
+        std::shared_ptr<container_t> c = it.second.lock();
+        if (c) {
+            // same order as above
+            for(uint32_t i = 0; i < p.containers; ++i) {
+                if (sorted[i]->second == c) {
+                    m.container = static_cast<int32_t>(i);
+                    break;
+                }
+            }
+        }
+        auto t = _topology.find(it.first);
+        if (t != _topology.end()) {
+            m.left = t->second.rect.left;
+            m.top = t->second.rect.top;
+            m.right = t->second.rect.right;
+            m.bottom = t->second.rect.bottom;
+            copy_name(m.device, sizeof(m.device) / sizeof(m.device[0]), t->second.device);
+        }
+    }
+
+    const char* src = reinterpret_cast<const char*>(&p);
+    const uint64_t seq = _segment->seq.load(std::memory_order_relaxed);
+    _segment->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for(size_t w = 0; w < status_segment_t::WORDS; ++w) {
+        uint64_t word;
+        std::memcpy(&word, src + w * 8, 8);
+        _segment->words[w].store(word, std::memory_order_relaxed);
+    }
+    _segment->seq.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,100 @@
+#ifndef _LIBTTWWAM_STATUS_H_
+#define _LIBTTWWAM_STATUS_H_
+
+// the containers and which one is shown on each monitor, published in
+// shared memory for status bars
+//
+// the segment has a fixed layout and is protected by a seqlock: the writer
+// makes the sequence odd, stores the payload and makes it even again, so
+// publishing is a handful of plain stores. readers copy the payload and
+// retry if the sequence was odd or changed meanwhile, any number of them
+// can poll without ever blocking the writer. the payload is stored as
+// relaxed atomic words so the racing copies are well defined.
+//
+// on windows the writer maps it as STATUS_SEGMENT_NAME. names are UTF-16,
+// NUL padded and truncated to STATUS_NAME - 1 code units.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+const uint32_t STATUS_MAGIC = 0x4d575454; // "TTWM"
+const uint32_t STATUS_VERSION = 1;
+const size_t STATUS_NAME = 64;
+const size_t STATUS_MONITORS = 16;
+const size_t STATUS_CONTAINERS = 64;
+const wchar_t* const STATUS_SEGMENT_NAME = L"Local\\ttwwam-status";
+
+struct status_monitor_t {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+    // index into status_payload_t::container, -1 if none is shown
+    int32_t container;
+    uint32_t reserved;
+    char16_t device[32];
+};
+
+struct status_payload_t {
+    uint32_t magic;
+    uint32_t version;
+    // incremented by every publish
+    uint64_t changes;
+    uint32_t monitors;
+    uint32_t containers;
+    status_monitor_t monitor[STATUS_MONITORS];
+    // in name order
+    char16_t container[STATUS_CONTAINERS][STATUS_NAME];
+};
+
+static_assert(sizeof(status_payload_t) % 8 == 0, "copied in 64 bit words");
+
+struct status_segment_t {
+    static const size_t WORDS = sizeof(status_payload_t) / 8;
+
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[WORDS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock is shared between processes");
+
+// the writer, `segment` is zeroed shared memory or null to stop publishing
+void status_attach(status_segment_t* segment);
+// copies the current containers into the segment, if attached
+void publish_status();
+
+// the reader. false if the writer kept changing it for `tries` attempts or
+// it's not a segment this version understands.
+inline bool read_status(const status_segment_t& segment, status_payload_t& out, unsigned tries = 1000)
+{
+    char* dst = reinterpret_cast<char*>(&out);
+    for(unsigned i = 0; i < tries; ++i) {
+        const uint64_t before = segment.seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        for(size_t w = 0; w < status_segment_t::WORDS; ++w) {
+            const uint64_t word = segment.words[w].load(std::memory_order_relaxed);
+            std::memcpy(dst + w * 8, &word, 8);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment.seq.load(std::memory_order_relaxed) == before) {
+            return before && out.magic == STATUS_MAGIC && out.version == STATUS_VERSION;
+        }
+    }
+    return false;
+}
+
+inline std::u16string_view status_name(const char16_t* name, size_t size)
+{
+    size_t n = 0;
+    while (n < size && name[n]) {
+        ++n;
+    }
+    return std::u16string_view(name, n);
+}
+
+#endif // _LIBTTWWAM_STATUS_H_
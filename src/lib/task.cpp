@@ -0,0 +1,164 @@
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <map>
+#include <string>
+
+#include "task.h"
+
+using std::string;
+
+typedef std::chrono::steady_clock task_clock_t;
+
+task_stats_t _task_stats;
+
+struct task_record_t {
+    string lane;
+    task_t::handle_t handle;
+    std::function<void(bool)> done;
+    bool cancelled = false;
+};
+
+static uint64_t _next_task_id = 1;
+static std::map<uint64_t, task_record_t> _tasks;
+// the task running in each lane
+static std::map<string, uint64_t, std::less<>> _lanes;
+// ids of tasks to resume, or destroy if cancelled. ids of tasks that are
+// gone already are skipped.
+static std::deque<uint64_t> _ready;
+static std::multimap<task_clock_t::time_point, uint64_t> _timers;
+
+void task_t::promise_type::unhandled_exception()
+{
+    // commands don't throw, same as everything else in here
+    std::fputs("unhandled exception in a task\n", stderr);
+    std::terminate();
+}
+
+static void finish_task(std::map<uint64_t, task_record_t>::iterator it)
+{
+    task_record_t& t = it->second;
+    auto lane = _lanes.find(t.lane);
+    if (lane != _lanes.end() && lane->second == it->first) {
+        _lanes.erase(lane);
+    }
+    t.handle.destroy();
+    _tasks.erase(it);
+}
+
+// resumes until the next suspension, or destroys it if it got cancelled
+static void resume_task(uint64_t id)
+{
+    auto it = _tasks.find(id);
+    if (it == _tasks.end()) {
+        return;
+    }
+    if (it->second.cancelled) {
+        ++_task_stats.cancelled;
+        finish_task(it);
+        return;
+    }
+    ++_task_stats.resumed;
+    task_t::handle_t h = it->second.handle;
+    h.resume();
+    if (!h.done()) {
+        return;
+    }
+    // `done` may start another task, don't hold on to the iterator
+    std::function<void(bool)> done = std::move(it->second.done);
+    bool result = h.promise().result;
+    ++_task_stats.completed;
+    finish_task(it);
+    if (done) {
+        done(result);
+    }
+}
+
+void start_task(std::string_view lane, task_t task, std::function<void(bool)> done)
+{
+    cancel_task(lane);
+    const uint64_t id = _next_task_id++;
+    task_record_t& t = _tasks[id];
+    t.lane.assign(lane);
+    t.handle = task.release();
+    t.handle.promise().id = id;
+    t.done = std::move(done);
+    _lanes[t.lane] = id;
+    ++_task_stats.started;
+    resume_task(id);
+}
+
+void cancel_task(std::string_view lane)
+{
+    auto it = _lanes.find(lane);
+    if (it == _lanes.end()) {
+        return;
+    }
+    auto t = _tasks.find(it->second);
+    _lanes.erase(it);
+    if (t != _tasks.end() && !t->second.cancelled) {
+        t->second.cancelled = true;
+        // destroyed by the next run_tasks() instead of waiting for whatever
+        // it's suspended on
+        _ready.push_back(t->first);
+    }
+}
+
+void cancel_tasks()
+{
+    for(auto& it: _tasks) {
+        it.second.handle.destroy();
+        ++_task_stats.cancelled;
+    }
+    _tasks.clear();
+    _lanes.clear();
+    _ready.clear();
+    _timers.clear();
+}
+
+size_t running_tasks()
+{
+    return _tasks.size();
+}
+
+void run_tasks()
+{
+    const auto now = task_clock_t::now();
+    while (!_timers.empty() && _timers.begin()->first <= now) {
+        _ready.push_back(_timers.begin()->second);
+        _timers.erase(_timers.begin());
+    }
+    std::deque<uint64_t> ready;
+    ready.swap(_ready);
+    for(uint64_t id: ready) {
+        resume_task(id);
+    }
+}
+
+int next_task_ms()
+{
+    if (!_ready.empty()) {
+        return 0;
+    }
+    // timers of tasks that are gone still count, they just wake us up once
+    if (_timers.empty()) {
+        return -1;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(_timers.begin()->first - task_clock_t::now());
+    return wait.count() > 0 ? static_cast<int>(wait.count()) : 0;
+}
+
+void wake_task(uint64_t id)
+{
+    _ready.push_back(id);
+}
+
+void task_sleep_t::await_suspend(task_t::handle_t h)
+{
+    if (delay.count() <= 0) {
+        wake_task(h.promise().id);
+        return;
+    }
+    _timers.emplace(task_clock_t::now() + delay, h.promise().id);
+}
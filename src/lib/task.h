@@ -0,0 +1,102 @@
+#ifndef _LIBTTWWAM_TASK_H_
+#define _LIBTTWWAM_TASK_H_
+
+// commands as coroutines that wait for timers, scans or windows without
+// blocking the message loop.
+//
+// everything here runs on the thread of the frontend's loop, which calls
+// run_tasks() whenever next_task_ms() says something is due. each task
+// belongs to a lane and starting a task cancels the one already running in
+// its lane, e.g. confirming another command supersedes the last one.
+// cancelled tasks are destroyed where they're suspended (so their locals
+// are cleaned up) instead of being resumed.
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+class task_t {
+public:
+    struct promise_type {
+        uint64_t id = 0;
+        bool result = false;
+
+        task_t get_return_object()
+        {
+            return task_t(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // started by start_task(), finished ones are destroyed by run_tasks()
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(bool r) { result = r; }
+        void unhandled_exception();
+    };
+    typedef std::coroutine_handle<promise_type> handle_t;
+
+    task_t(task_t&& other) noexcept
+        : _handle(std::exchange(other._handle, nullptr))
+    {}
+    task_t(const task_t&) = delete;
+    task_t& operator=(const task_t&) = delete;
+    task_t& operator=(task_t&&) = delete;
+
+    ~task_t()
+    {
+        // never started
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    handle_t release() { return std::exchange(_handle, nullptr); }
+
+private:
+    explicit task_t(handle_t h)
+        : _handle(h)
+    {}
+
+    handle_t _handle;
+};
+
+struct task_stats_t {
+    size_t started = 0;
+    size_t completed = 0;
+    size_t cancelled = 0;
+    size_t resumed = 0;
+};
+
+extern task_stats_t _task_stats;
+
+// runs `task` up to its first suspension, `done` gets its result when it
+// completes (not when it's cancelled)
+void start_task(std::string_view lane, task_t task, std::function<void(bool)> done = {});
+void cancel_task(std::string_view lane);
+// destroys all tasks, on exit and between replays
+void cancel_tasks();
+size_t running_tasks();
+// resumes the tasks that became ready before the call, the ones that
+// become ready while it runs wait for the next call so input isn't starved
+void run_tasks();
+// until run_tasks() has something to do, 0 if it has now, -1 if nothing
+// is waiting on a timer
+int next_task_ms();
+// queues task `id` to be resumed, for awaitables
+void wake_task(uint64_t id);
+
+// resumes after `ms`, 0 just lets the loop handle the pending input first
+struct task_sleep_t {
+    std::chrono::milliseconds delay;
+
+    explicit task_sleep_t(unsigned ms)
+        : delay(ms)
+    {}
+
+    bool await_ready() const { return false; }
+    void await_suspend(task_t::handle_t h);
+    void await_resume() const {}
+};
+
+#endif // _LIBTTWWAM_TASK_H_
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <map>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "core.h"
+#include "throttle.h"
+
+using std::wstring;
+
+throttle_policy_t _throttle_policy;
+throttle_stats_t _throttle_stats;
+
+struct throttled_t {
+    std::chrono::steady_clock::time_point since;
+    process_usage_t usage;
+    bool usage_valid;
+};
+
+static std::map<uint32_t, throttled_t> _throttled;
+// lowercase executable names of the processes with tracked windows, pids
+// get reused so the ones without any are dropped again
+static std::unordered_map<uint32_t, wstring> _process_names;
+
+static bool allowed(uint32_t pid)
+{
+    auto it = _process_names.find(pid);
+    if (it == _process_names.end()) {
+        static wstring name;
+        winsys().process_name(pid, name);
+        it = _process_names.emplace(pid, wstring()).first;
+        string_pool_t::to_lower(name, it->second);
+    }
+    const wstring& lower = it->second;
+    if (lower.empty()) {
+        return false;
+    }
+    if (_throttle_policy.deny.find(lower) != _throttle_policy.deny.end()) {
+        return false;
+    }
+    return _throttle_policy.allow.empty() || _throttle_policy.allow.find(lower) != _throttle_policy.allow.end();
+}
+
+static void throttle(uint32_t pid)
+{
+    winsys_t& ws = winsys();
+    throttled_t t;
+    t.since = std::chrono::steady_clock::now();
+    t.usage_valid = ws.process_usage(pid, t.usage);
+    if (!ws.throttle_process(pid, true, _throttle_policy.trim)) {
+        ++_throttle_stats.failed;
+        return;
+    }
+    process_usage_t after;
+    if (_throttle_policy.trim && t.usage_valid && ws.process_usage(pid, after)
+            && after.working_set < t.usage.working_set) {
+        _throttle_stats.trimmed_bytes += t.usage.working_set - after.working_set;
+    }
+    _throttled[pid] = t;
+    ++_throttle_stats.throttled;
+}
+
+static void restore(std::map<uint32_t, throttled_t>::iterator it)
+{
+    winsys_t& ws = winsys();
+    const throttled_t& t = it->second;
+    process_usage_t now;
+    if (t.usage_valid && ws.process_usage(it->first, now) && now.cpu_us >= t.usage.cpu_us) {
+        _throttle_stats.throttled_cpu_us += now.cpu_us - t.usage.cpu_us;
+    }
+    _throttle_stats.throttled_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t.since).count();
+    // the process might be gone, nothing to restore then
+    ws.throttle_process(it->first, false, false);
+    ++_throttle_stats.restored;
+    _throttled.erase(it);
+}
+
+void throttle_hidden_processes(const container_t& c)
+{
+    if (!_throttle_policy.enabled) {
+        return;
+    }
+
+    // processes with a window in `c` and whether they have any tracked
+    // window that's still shown
+    std::unordered_map<uint32_t, bool> shown;
+    for(const auto& w: c.wmap) {
+        if (w.second.pid) {
+            shown.emplace(w.second.pid, false);
+        }
+    }
+    static std::unordered_set<uint32_t> live;
+    live.clear();
+    for(const auto& it: _containers) {
+        for(const auto& w: it.second->wmap) {
+            live.insert(w.second.pid);
+            auto found = shown.find(w.second.pid);
+            if (found != shown.end() && w.second.shown) {
+                found->second = true;
+            }
+        }
+    }
+    for(auto it = _process_names.begin(); it != _process_names.end();) {
+        it = live.count(it->first) ? std::next(it) : _process_names.erase(it);
+    }
+
+    for(const auto& it: shown) {
+        if (it.second || _throttled.find(it.first) != _throttled.end()) {
+            continue;
+        }
+        if (allowed(it.first)) {
+            throttle(it.first);
+        }
+    }
+}
+
+void restore_process(uint32_t pid)
+{
+    if (_throttled.empty()) {
+        return;
+    }
+    auto it = _throttled.find(pid);
+    if (it != _throttled.end()) {
+        restore(it);
+    }
+}
+
+void restore_processes(const container_t& c)
+{
+    if (_throttled.empty()) {
+        return;
+    }
+    for(const auto& w: c.wmap) {
+        restore_process(w.second.pid);
+    }
+}
+
+void restore_all_processes()
+{
+    while (!_throttled.empty()) {
+        restore(_throttled.begin());
+    }
+}
+
+size_t throttled_processes()
+{
+    return _throttled.size();
+}
+
+void throttle_reset()
+{
+    _throttled.clear();
+    _process_names.clear();
+    _throttle_stats = throttle_stats_t();
+}
@@ -0,0 +1,50 @@
+#ifndef _LIBTTWWAM_THROTTLE_H_
+#define _LIBTTWWAM_THROTTLE_H_
+
+// lowers the priority of processes whose windows are all in hidden
+// containers, opt-in
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+
+struct container_t;
+
+struct throttle_policy_t {
+    bool enabled = false;
+    // also empty their working sets
+    bool trim = false;
+    // lowercase executable names. if `allow` isn't empty only those are
+    // throttled, the ones in `deny` never are.
+    std::set<std::wstring, std::less<>> allow;
+    std::set<std::wstring, std::less<>> deny;
+};
+
+struct throttle_stats_t {
+    size_t throttled = 0;
+    size_t restored = 0;
+    size_t failed = 0;
+    // working sets emptied by trimming
+    uint64_t trimmed_bytes = 0;
+    // CPU time used and wall time spent by processes while throttled
+    uint64_t throttled_cpu_us = 0;
+    uint64_t throttled_us = 0;
+};
+
+extern throttle_policy_t _throttle_policy;
+extern throttle_stats_t _throttle_stats;
+
+// after `c` got hidden
+void throttle_hidden_processes(const container_t& c);
+// before `c` gets shown
+void restore_processes(const container_t& c);
+// a scan found a window of `pid` in a shown container
+void restore_process(uint32_t pid);
+// when disabling the policy and on exit
+void restore_all_processes();
+size_t throttled_processes();
+// forget throttled processes and stats without restoring, for replays
+void throttle_reset();
+
+#endif // _LIBTTWWAM_THROTTLE_H_
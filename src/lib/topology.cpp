@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "topology.h"
+
+using std::vector;
+using std::wstring_view;
+
+bool same_rect(const rect_t& a, const rect_t& b)
+{
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+static wstring_view device_key(const monitor_info_t& info)
+{
+    return info.path.empty() ? wstring_view(info.device) : wstring_view(info.path);
+}
+
+// device paths are stable, \\.\DISPLAYn names get renumbered
+static bool stable_key(const monitor_info_t& info)
+{
+    return !info.path.empty();
+}
+
+static uint64_t rect_key(const rect_t& r)
+{
+    // monitors don't overlap, the top left corner is enough
+    return (static_cast<uint64_t>(static_cast<uint32_t>(r.left)) << 32) | static_cast<uint32_t>(r.top);
+}
+
+vector<monitor_remap_t> match_monitors(const topology_t& before, const topology_t& after)
+{
+    // still unmatched monitors of `after`, by device and by position
+    std::unordered_multimap<wstring_view, hmonitor_t> by_device;
+    std::unordered_multimap<uint64_t, hmonitor_t> by_rect;
+    for(const auto& it: after) {
+        by_device.emplace(device_key(it.second), it.first);
+        by_rect.emplace(rect_key(it.second.rect), it.first);
+    }
+
+    auto take = [&](hmonitor_t hmon) {
+        const monitor_info_t& info = after.find(hmon)->second;
+        for(auto range = by_device.equal_range(device_key(info)); range.first != range.second; ++range.first) {
+            if (range.first->second == hmon) {
+                by_device.erase(range.first);
+                break;
+            }
+        }
+        for(auto range = by_rect.equal_range(rect_key(info.rect)); range.first != range.second; ++range.first) {
+            if (range.first->second == hmon) {
+                by_rect.erase(range.first);
+                break;
+            }
+        }
+    };
+
+    vector<monitor_remap_t> out;
+    out.reserve(before.size());
+    for(const auto& it: before) {
+        out.push_back({it.first, nullptr, false});
+    }
+
+    // device and geometry
+    size_t i = 0;
+    for(auto it = before.begin(); it != before.end(); ++it, ++i) {
+        for(auto range = by_device.equal_range(device_key(it->second)); range.first != range.second; ++range.first) {
+            hmonitor_t to = range.first->second;
+            if (same_rect(after.find(to)->second.rect, it->second.rect)) {
+                out[i].to = to;
+                take(to);
+                break;
+            }
+        }
+    }
+
+    // device alone, the resolution or arrangement changed. `stable` first,
+    // a renumbered name says less than the position a screen is at.
+    auto by_device_alone = [&](bool stable) {
+        size_t i = 0;
+        for(auto it = before.begin(); it != before.end(); ++it, ++i) {
+            if (out[i].to || stable_key(it->second) != stable) {
+                continue;
+            }
+            // screens of the same model may share a path, the one that
+            // stayed at its position is the better guess
+            auto range = by_device.equal_range(device_key(it->second));
+            auto found = range.first == range.second ? by_device.end() : range.first;
+            for(; range.first != range.second; ++range.first) {
+                if (rect_key(after.find(range.first->second)->second.rect) == rect_key(it->second.rect)) {
+                    found = range.first;
+                    break;
+                }
+            }
+            if (found != by_device.end()) {
+                out[i].to = found->second;
+                out[i].moved = true;
+                take(found->second);
+            }
+        }
+    };
+    by_device_alone(true);
+
+    // geometry alone, the same screen got a different device name
+    i = 0;
+    for(auto it = before.begin(); it != before.end(); ++it, ++i) {
+        if (out[i].to) {
+            continue;
+        }
+        auto found = by_rect.find(rect_key(it->second.rect));
+        if (found != by_rect.end()) {
+            const monitor_info_t& info = after.find(found->second)->second;
+            out[i].to = found->second;
+            out[i].moved = !same_rect(info.rect, it->second.rect);
+            take(found->second);
+        }
+    }
+
+    // names alone, for screens that changed both
+    by_device_alone(false);
+    return out;
+}
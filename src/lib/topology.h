@@ -0,0 +1,33 @@
+#ifndef _LIBTTWWAM_TOPOLOGY_H_
+#define _LIBTTWWAM_TOPOLOGY_H_
+
+#include <map>
+#include <vector>
+
+#include "winsys.h"
+
+// HMONITORs don't survive display changes, they're handed out anew whenever
+// the configuration changes. monitors are identified by their device path
+// (or name, if there's no path) and their geometry instead.
+typedef std::map<hmonitor_t, monitor_info_t> topology_t;
+
+// where a monitor of the previous topology ended up
+struct monitor_remap_t {
+    hmonitor_t from;
+    // null if the monitor is gone
+    hmonitor_t to;
+    // resolution or position changed
+    bool moved;
+};
+
+// matches the monitors of `before` to the ones of `after`, first by device
+// and geometry, then by device path alone (resolution changes), by geometry
+// alone (devices renumbered after docking/undocking) and finally by device
+// name alone. names are only trusted after geometry since they get
+// renumbered. every monitor is matched at most once. pure function, no
+// window system involved.
+std::vector<monitor_remap_t> match_monitors(const topology_t& before, const topology_t& after);
+
+bool same_rect(const rect_t& a, const rect_t& b);
+
+#endif // _LIBTTWWAM_TOPOLOGY_H_
@@ -0,0 +1,769 @@
+#include <thread>
+
+#include "trace.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using std::wstring;
+using std::wstring_view;
+
+static const char TRACE_MAGIC[4] = {'T', 'T', 'W', 'T'};
+// flush to the file once that much has been buffered
+static const size_t TRACE_FLUSH_SIZE = 64 * 1024;
+
+const char* trace_op_name(uint8_t op)
+{
+    switch (op) {
+        case TRACE_ENUM_MONITORS: return "enum_monitors";
+        case TRACE_MONITOR_INFO: return "monitor_info";
+        case TRACE_CURSOR_MONITOR: return "cursor_monitor";
+        case TRACE_ENUM_WINDOWS: return "enum_windows";
+        case TRACE_SHELL_WINDOW: return "shell_window";
+        case TRACE_IS_VISIBLE: return "is_visible";
+        case TRACE_TITLE_LENGTH: return "title_length";
+        case TRACE_TITLE: return "title";
+        case TRACE_WINDOW_MONITOR: return "window_monitor";
+        case TRACE_WINDOW_RECT: return "window_rect";
+        case TRACE_SHOW_WINDOW: return "show_window";
+        case TRACE_MOVE_WINDOW: return "move_window";
+        case TRACE_CLOSE_WINDOW: return "close_window";
+        case TRACE_WINDOW_SHOW_STATE: return "window_show_state";
+        case TRACE_WINDOW_CLASS: return "window_class";
+        case TRACE_CLOAK_WINDOW: return "cloak_window";
+        case TRACE_WINDOW_PROCESS: return "window_process";
+        case TRACE_PROCESS_NAME: return "process_name";
+        case TRACE_PROCESS_USAGE: return "process_usage";
+        case TRACE_THROTTLE_PROCESS: return "throttle_process";
+        case TRACE_FOREGROUND_WINDOW: return "foreground_window";
+        case TRACE_RESTACK_WINDOWS: return "restack_windows";
+        case TRACE_IS_WINDOW: return "is_window";
+        case TRACE_SCAN: return "scan";
+        case TRACE_BUILD: return "build";
+        case TRACE_APPLY: return "apply";
+        case TRACE_SWITCH: return "switch";
+        case TRACE_PREVIEW: return "preview";
+        case TRACE_DISPLAY_CHANGE: return "display_change";
+        case TRACE_UNDO: return "undo";
+        case TRACE_REDO: return "redo";
+        case TRACE_MOVE: return "move";
+        case TRACE_INPUT: return "input";
+        case TRACE_IDLE: return "idle";
+    }
+    return "unknown";
+}
+
+static void put_uvar(string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+trace_record_t& trace_record_t::u(uint64_t v)
+{
+    put_uvar(_bytes, v);
+    return *this;
+}
+
+trace_record_t& trace_record_t::s(int64_t v)
+{
+    put_uvar(_bytes, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+    return *this;
+}
+
+trace_record_t& trace_record_t::str(wstring_view v)
+{
+    u(v.size());
+    for(wchar_t ch: v) {
+        u(static_cast<uint16_t>(ch));
+    }
+    return *this;
+}
+
+trace_record_t& trace_record_t::rect(const rect_t& r)
+{
+    return s(r.left).s(r.top).s(r.right).s(r.bottom);
+}
+
+unique_ptr<trace_writer_t> trace_writer_t::open(const string& path)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        return unique_ptr<trace_writer_t>();
+    }
+    return unique_ptr<trace_writer_t>(new trace_writer_t(f));
+}
+
+trace_writer_t::trace_writer_t(FILE* f)
+    : _f(f), _t0(std::chrono::steady_clock::now())
+{
+    _buffer.append(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    _buffer.push_back(static_cast<char>(TRACE_VERSION));
+}
+
+trace_writer_t::~trace_writer_t()
+{
+    flush();
+    std::fclose(_f);
+}
+
+uint64_t trace_writer_t::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - _t0).count();
+}
+
+void trace_writer_t::write(uint8_t op, uint64_t start, const trace_record_t& rec)
+{
+    uint64_t duration = now() - start;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buffer.push_back(static_cast<char>(op));
+    put_uvar(_buffer, start);
+    put_uvar(_buffer, duration);
+    put_uvar(_buffer, rec.bytes().size());
+    _buffer.append(rec.bytes());
+    if (_buffer.size() >= TRACE_FLUSH_SIZE) {
+        flush_locked();
+    }
+}
+
+void trace_writer_t::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    flush_locked();
+}
+
+void trace_writer_t::flush_locked()
+{
+    std::fwrite(_buffer.data(), 1, _buffer.size(), _f);
+    std::fflush(_f);
+    _buffer.clear();
+}
+
+uint64_t trace_cursor_t::u()
+{
+    uint64_t v = 0;
+    for(int shift = 0; shift < 64; shift += 7) {
+        if (_p >= _end) {
+            _ok = false;
+            return 0;
+        }
+        uint8_t b = *_p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    _ok = false;
+    return 0;
+}
+
+int64_t trace_cursor_t::s()
+{
+    uint64_t v = u();
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+void trace_cursor_t::str(wstring& out)
+{
+    uint64_t n = u();
+    if (n > static_cast<uint64_t>(_end - _p)) {
+        // every code unit takes at least a byte
+        _ok = false;
+        out.clear();
+        return;
+    }
+    out.resize(n);
+    for(uint64_t i = 0; i < n; ++i) {
+        out[i] = static_cast<wchar_t>(u());
+    }
+}
+
+rect_t trace_cursor_t::rect()
+{
+    rect_t r;
+    r.left = static_cast<int32_t>(s());
+    r.top = static_cast<int32_t>(s());
+    r.right = static_cast<int32_t>(s());
+    r.bottom = static_cast<int32_t>(s());
+    return r;
+}
+
+bool trace_t::load(const string& path)
+{
+    _bytes.clear();
+    _entries.clear();
+
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    char buf[64 * 1024];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+        _bytes.insert(_bytes.end(), buf, buf + n);
+    }
+    std::fclose(f);
+
+    const size_t header = sizeof(TRACE_MAGIC) + 1;
+    if (_bytes.size() < header
+            || !std::equal(TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC), _bytes.begin())
+            || _bytes[sizeof(TRACE_MAGIC)] != TRACE_VERSION) {
+        return false;
+    }
+
+    const uint8_t* p = _bytes.data() + header;
+    const uint8_t* end = _bytes.data() + _bytes.size();
+    while (p < end) {
+        trace_entry_t e;
+        e.op = *p++;
+        trace_entry_t rest = {0, 0, 0, p, static_cast<size_t>(end - p)};
+        trace_cursor_t c(rest);
+        e.start = c.u();
+        e.duration = c.u();
+        uint64_t size = c.u();
+        if (!c.ok() || size > static_cast<uint64_t>(end - c.position())) {
+            // truncated, e.g. the recording process died
+            break;
+        }
+        e.data = c.position();
+        e.size = static_cast<size_t>(size);
+        _entries.push_back(e);
+        p = e.data + e.size;
+    }
+    return true;
+}
+
+// times a call and writes it along with its arguments and results
+class trace_call_t {
+public:
+    trace_call_t(trace_writer_t& trace, uint8_t op)
+        : _trace(trace), _op(op), _start(trace.now())
+    {}
+    ~trace_call_t()
+    {
+        _trace.write(_op, _start, rec);
+    }
+
+    trace_record_t rec;
+
+private:
+    trace_writer_t& _trace;
+    uint8_t _op;
+    uint64_t _start;
+};
+
+void recording_winsys_t::enum_monitors(vector<hmonitor_t>& out)
+{
+    trace_call_t call(_trace, TRACE_ENUM_MONITORS);
+    _ws.enum_monitors(out);
+    call.rec.u(out.size());
+    for(hmonitor_t h: out) {
+        call.rec.handle(h);
+    }
+}
+
+bool recording_winsys_t::monitor_info(hmonitor_t hmon, monitor_info_t& info)
+{
+    trace_call_t call(_trace, TRACE_MONITOR_INFO);
+    bool ok = _ws.monitor_info(hmon, info);
+    call.rec.handle(hmon).u(ok);
+    if (ok) {
+        call.rec.rect(info.rect).rect(info.work).str(info.device).str(info.path).u(info.dpi);
+    }
+    return ok;
+}
+
+hmonitor_t recording_winsys_t::cursor_monitor()
+{
+    trace_call_t call(_trace, TRACE_CURSOR_MONITOR);
+    hmonitor_t hmon = _ws.cursor_monitor();
+    call.rec.handle(hmon);
+    return hmon;
+}
+
+void recording_winsys_t::enum_windows(vector<hwnd_t>& out)
+{
+    trace_call_t call(_trace, TRACE_ENUM_WINDOWS);
+    _ws.enum_windows(out);
+    call.rec.u(out.size());
+    for(hwnd_t h: out) {
+        call.rec.handle(h);
+    }
+}
+
+hwnd_t recording_winsys_t::shell_window()
+{
+    trace_call_t call(_trace, TRACE_SHELL_WINDOW);
+    hwnd_t hwnd = _ws.shell_window();
+    call.rec.handle(hwnd);
+    return hwnd;
+}
+
+bool recording_winsys_t::is_window(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_IS_WINDOW);
+    bool alive = _ws.is_window(hwnd);
+    call.rec.handle(hwnd).u(alive);
+    return alive;
+}
+
+bool recording_winsys_t::is_visible(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_IS_VISIBLE);
+    bool visible = _ws.is_visible(hwnd);
+    call.rec.handle(hwnd).u(visible);
+    return visible;
+}
+
+int recording_winsys_t::title_length(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_TITLE_LENGTH);
+    int n = _ws.title_length(hwnd);
+    call.rec.handle(hwnd).s(n);
+    return n;
+}
+
+void recording_winsys_t::title(hwnd_t hwnd, wstring& out)
+{
+    trace_call_t call(_trace, TRACE_TITLE);
+    _ws.title(hwnd, out);
+    call.rec.handle(hwnd).str(out);
+}
+
+hmonitor_t recording_winsys_t::window_monitor(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_WINDOW_MONITOR);
+    hmonitor_t hmon = _ws.window_monitor(hwnd);
+    call.rec.handle(hwnd).handle(hmon);
+    return hmon;
+}
+
+bool recording_winsys_t::window_rect(hwnd_t hwnd, rect_t& r)
+{
+    trace_call_t call(_trace, TRACE_WINDOW_RECT);
+    bool ok = _ws.window_rect(hwnd, r);
+    call.rec.handle(hwnd).u(ok);
+    if (ok) {
+        call.rec.rect(r);
+    }
+    return ok;
+}
+
+window_show_t recording_winsys_t::window_show_state(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_WINDOW_SHOW_STATE);
+    window_show_t state = _ws.window_show_state(hwnd);
+    call.rec.handle(hwnd).u(state);
+    return state;
+}
+
+void recording_winsys_t::window_class(hwnd_t hwnd, wstring& out)
+{
+    trace_call_t call(_trace, TRACE_WINDOW_CLASS);
+    _ws.window_class(hwnd, out);
+    call.rec.handle(hwnd).str(out);
+}
+
+uint32_t recording_winsys_t::window_process(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_WINDOW_PROCESS);
+    uint32_t pid = _ws.window_process(hwnd);
+    call.rec.handle(hwnd).u(pid);
+    return pid;
+}
+
+void recording_winsys_t::show_window(hwnd_t hwnd, bool show)
+{
+    trace_call_t call(_trace, TRACE_SHOW_WINDOW);
+    _ws.show_window(hwnd, show);
+    call.rec.handle(hwnd).u(show);
+}
+
+bool recording_winsys_t::cloak_window(hwnd_t hwnd, bool cloak)
+{
+    trace_call_t call(_trace, TRACE_CLOAK_WINDOW);
+    bool ok = _ws.cloak_window(hwnd, cloak);
+    call.rec.handle(hwnd).u(cloak).u(ok);
+    return ok;
+}
+
+void recording_winsys_t::move_window(hwnd_t hwnd, const rect_t& r)
+{
+    trace_call_t call(_trace, TRACE_MOVE_WINDOW);
+    _ws.move_window(hwnd, r);
+    call.rec.handle(hwnd).rect(r);
+}
+
+void recording_winsys_t::close_window(hwnd_t hwnd)
+{
+    trace_call_t call(_trace, TRACE_CLOSE_WINDOW);
+    _ws.close_window(hwnd);
+    call.rec.handle(hwnd);
+}
+
+hwnd_t recording_winsys_t::foreground_window()
+{
+    trace_call_t call(_trace, TRACE_FOREGROUND_WINDOW);
+    hwnd_t hwnd = _ws.foreground_window();
+    call.rec.handle(hwnd);
+    return hwnd;
+}
+
+void recording_winsys_t::restack_windows(const vector<hwnd_t>& windows, hwnd_t focus)
+{
+    trace_call_t call(_trace, TRACE_RESTACK_WINDOWS);
+    _ws.restack_windows(windows, focus);
+    call.rec.handle(focus).u(windows.size());
+    for(hwnd_t hwnd: windows) {
+        call.rec.handle(hwnd);
+    }
+}
+
+void recording_winsys_t::process_name(uint32_t pid, wstring& out)
+{
+    trace_call_t call(_trace, TRACE_PROCESS_NAME);
+    _ws.process_name(pid, out);
+    call.rec.u(pid).str(out);
+}
+
+bool recording_winsys_t::process_usage(uint32_t pid, process_usage_t& out)
+{
+    trace_call_t call(_trace, TRACE_PROCESS_USAGE);
+    bool ok = _ws.process_usage(pid, out);
+    call.rec.u(pid).u(ok);
+    if (ok) {
+        call.rec.u(out.cpu_us).u(out.working_set);
+    }
+    return ok;
+}
+
+bool recording_winsys_t::throttle_process(uint32_t pid, bool throttle, bool trim)
+{
+    trace_call_t call(_trace, TRACE_THROTTLE_PROCESS);
+    bool ok = _ws.throttle_process(pid, throttle, trim);
+    call.rec.u(pid).u(throttle).u(trim).u(ok);
+    return ok;
+}
+
+// whether the first argument of the call is the handle it's about
+static bool keyed_by_handle(uint8_t op)
+{
+    switch (op) {
+        case TRACE_ENUM_MONITORS:
+        case TRACE_CURSOR_MONITOR:
+        case TRACE_ENUM_WINDOWS:
+        case TRACE_SHELL_WINDOW:
+        case TRACE_FOREGROUND_WINDOW:
+            return false;
+    }
+    return true;
+}
+
+replay_winsys_t::replay_winsys_t(const trace_t& trace, bool realtime)
+    : _realtime(realtime)
+{
+    for(const auto& e: trace.entries()) {
+        if (e.op >= TRACE_EVENT_BASE) {
+            continue;
+        }
+        uint64_t handle = 0;
+        if (keyed_by_handle(e.op)) {
+            trace_cursor_t c(e);
+            handle = c.u();
+        }
+        _queues[key_t(e.op, handle)].entries.push_back(&e);
+    }
+}
+
+void replay_winsys_t::rewind()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto& q: _queues) {
+        q.second.next = 0;
+    }
+    _calls = 0;
+    _misses = 0;
+}
+
+const trace_entry_t* replay_winsys_t::next(uint8_t op, const void* handle)
+{
+    const trace_entry_t* e = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls;
+        auto it = _queues.find(key_t(op, reinterpret_cast<uintptr_t>(handle)));
+        if (it == _queues.end()) {
+            ++_misses;
+            return nullptr;
+        }
+        queue_t& q = it->second;
+        e = q.entries[q.next];
+        if (q.next + 1 < q.entries.size()) {
+            ++q.next;
+        }
+    }
+    if (_realtime && e->duration) {
+        std::this_thread::sleep_for(std::chrono::microseconds(e->duration));
+    }
+    return e;
+}
+
+void replay_winsys_t::enum_monitors(vector<hmonitor_t>& out)
+{
+    out.clear();
+    const trace_entry_t* e = next(TRACE_ENUM_MONITORS, nullptr);
+    if (!e) {
+        return;
+    }
+    trace_cursor_t c(*e);
+    for(uint64_t n = c.u(); n && c.ok(); --n) {
+        out.push_back(c.handle<hmonitor_t>());
+    }
+}
+
+bool replay_winsys_t::monitor_info(hmonitor_t hmon, monitor_info_t& info)
+{
+    const trace_entry_t* e = next(TRACE_MONITOR_INFO, hmon);
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    if (!c.u()) {
+        return false;
+    }
+    info.rect = c.rect();
+    info.work = c.rect();
+    c.str(info.device);
+    c.str(info.path);
+    info.dpi = static_cast<uint32_t>(c.u());
+    return c.ok();
+}
+
+hmonitor_t replay_winsys_t::cursor_monitor()
+{
+    const trace_entry_t* e = next(TRACE_CURSOR_MONITOR, nullptr);
+    if (!e) {
+        return nullptr;
+    }
+    return trace_cursor_t(*e).handle<hmonitor_t>();
+}
+
+void replay_winsys_t::enum_windows(vector<hwnd_t>& out)
+{
+    out.clear();
+    const trace_entry_t* e = next(TRACE_ENUM_WINDOWS, nullptr);
+    if (!e) {
+        return;
+    }
+    trace_cursor_t c(*e);
+    for(uint64_t n = c.u(); n && c.ok(); --n) {
+        out.push_back(c.handle<hwnd_t>());
+    }
+}
+
+hwnd_t replay_winsys_t::shell_window()
+{
+    const trace_entry_t* e = next(TRACE_SHELL_WINDOW, nullptr);
+    if (!e) {
+        return nullptr;
+    }
+    return trace_cursor_t(*e).handle<hwnd_t>();
+}
+
+bool replay_winsys_t::is_window(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_IS_WINDOW, hwnd);
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return c.u() != 0;
+}
+
+bool replay_winsys_t::is_visible(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_IS_VISIBLE, hwnd);
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return c.u() != 0;
+}
+
+int replay_winsys_t::title_length(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_TITLE_LENGTH, hwnd);
+    if (!e) {
+        return 0;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return static_cast<int>(c.s());
+}
+
+void replay_winsys_t::title(hwnd_t hwnd, wstring& out)
+{
+    out.clear();
+    const trace_entry_t* e = next(TRACE_TITLE, hwnd);
+    if (!e) {
+        return;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    c.str(out);
+}
+
+hmonitor_t replay_winsys_t::window_monitor(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_WINDOW_MONITOR, hwnd);
+    if (!e) {
+        return nullptr;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return c.handle<hmonitor_t>();
+}
+
+bool replay_winsys_t::window_rect(hwnd_t hwnd, rect_t& r)
+{
+    const trace_entry_t* e = next(TRACE_WINDOW_RECT, hwnd);
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    if (!c.u()) {
+        return false;
+    }
+    r = c.rect();
+    return c.ok();
+}
+
+window_show_t replay_winsys_t::window_show_state(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_WINDOW_SHOW_STATE, hwnd);
+    if (!e) {
+        return WINDOW_NORMAL;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return static_cast<window_show_t>(c.u());
+}
+
+void replay_winsys_t::window_class(hwnd_t hwnd, wstring& out)
+{
+    out.clear();
+    const trace_entry_t* e = next(TRACE_WINDOW_CLASS, hwnd);
+    if (!e) {
+        return;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    c.str(out);
+}
+
+uint32_t replay_winsys_t::window_process(hwnd_t hwnd)
+{
+    const trace_entry_t* e = next(TRACE_WINDOW_PROCESS, hwnd);
+    if (!e) {
+        return 0;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    return static_cast<uint32_t>(c.u());
+}
+
+void replay_winsys_t::show_window(hwnd_t hwnd, bool /*show*/)
+{
+    next(TRACE_SHOW_WINDOW, hwnd);
+}
+
+bool replay_winsys_t::cloak_window(hwnd_t hwnd, bool /*cloak*/)
+{
+    const trace_entry_t* e = next(TRACE_CLOAK_WINDOW, hwnd);
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    c.u();
+    return c.u() != 0;
+}
+
+void replay_winsys_t::move_window(hwnd_t hwnd, const rect_t& /*r*/)
+{
+    next(TRACE_MOVE_WINDOW, hwnd);
+}
+
+void replay_winsys_t::close_window(hwnd_t hwnd)
+{
+    next(TRACE_CLOSE_WINDOW, hwnd);
+}
+
+hwnd_t replay_winsys_t::foreground_window()
+{
+    const trace_entry_t* e = next(TRACE_FOREGROUND_WINDOW, nullptr);
+    if (!e) {
+        return nullptr;
+    }
+    return trace_cursor_t(*e).handle<hwnd_t>();
+}
+
+void replay_winsys_t::restack_windows(const vector<hwnd_t>& /*windows*/, hwnd_t focus)
+{
+    next(TRACE_RESTACK_WINDOWS, focus);
+}
+
+// process ids are keyed like handles
+static const void* pid_key(uint32_t pid)
+{
+    return reinterpret_cast<const void*>(static_cast<uintptr_t>(pid));
+}
+
+void replay_winsys_t::process_name(uint32_t pid, wstring& out)
+{
+    out.clear();
+    const trace_entry_t* e = next(TRACE_PROCESS_NAME, pid_key(pid));
+    if (!e) {
+        return;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    c.str(out);
+}
+
+bool replay_winsys_t::process_usage(uint32_t pid, process_usage_t& out)
+{
+    const trace_entry_t* e = next(TRACE_PROCESS_USAGE, pid_key(pid));
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    if (!c.u()) {
+        return false;
+    }
+    out.cpu_us = c.u();
+    out.working_set = c.u();
+    return c.ok();
+}
+
+bool replay_winsys_t::throttle_process(uint32_t pid, bool /*throttle*/, bool /*trim*/)
+{
+    const trace_entry_t* e = next(TRACE_THROTTLE_PROCESS, pid_key(pid));
+    if (!e) {
+        return false;
+    }
+    trace_cursor_t c(*e);
+    c.u();
+    c.u();
+    c.u();
+    return c.u() != 0;
+}
@@ -0,0 +1,265 @@
+#ifndef _LIBTTWWAM_TRACE_H_
+#define _LIBTTWWAM_TRACE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "winsys.h"
+
+// binary trace of the window system calls ttwwam made and the events it
+// handled, see recording_winsys_t and replay_winsys_t.
+//
+// file layout: "TTWT", format version (1 byte), then records of
+//   op (1 byte), start (uvar, us since the trace started),
+//   duration (uvar, us), payload size (uvar), payload
+// payloads hold the arguments followed by the results. unsigned integers
+// are LEB128, signed ones zigzag encoded, strings are a length followed by
+// UTF-16 code units.
+const uint8_t TRACE_VERSION = 10;
+
+enum trace_op_t : uint8_t {
+    // window system calls
+    TRACE_ENUM_MONITORS = 1,
+    TRACE_MONITOR_INFO,
+    TRACE_CURSOR_MONITOR,
+    TRACE_ENUM_WINDOWS,
+    TRACE_SHELL_WINDOW,
+    TRACE_IS_VISIBLE,
+    TRACE_TITLE_LENGTH,
+    TRACE_TITLE,
+    TRACE_WINDOW_MONITOR,
+    TRACE_WINDOW_RECT,
+    TRACE_SHOW_WINDOW,
+    TRACE_MOVE_WINDOW,
+    TRACE_CLOSE_WINDOW,
+    TRACE_WINDOW_SHOW_STATE,
+    TRACE_WINDOW_CLASS,
+    TRACE_CLOAK_WINDOW,
+    TRACE_WINDOW_PROCESS,
+    TRACE_PROCESS_NAME,
+    TRACE_PROCESS_USAGE,
+    TRACE_THROTTLE_PROCESS,
+    TRACE_FOREGROUND_WINDOW,
+    TRACE_RESTACK_WINDOWS,
+    TRACE_IS_WINDOW,
+
+    // events, replayed by calling the matching core function
+    TRACE_EVENT_BASE = 0x80,
+    TRACE_SCAN = TRACE_EVENT_BASE,
+    TRACE_BUILD,
+    TRACE_APPLY,
+    // name, whether it scanned first
+    TRACE_SWITCH,
+    TRACE_PREVIEW,
+    TRACE_DISPLAY_CHANGE,
+    TRACE_UNDO,
+    TRACE_REDO,
+    // target, match, pattern
+    TRACE_MOVE,
+    // user input, informational only
+    TRACE_INPUT,
+    // a step of a housekeeping job, by name
+    TRACE_IDLE,
+};
+
+const char* trace_op_name(uint8_t op);
+
+// payload under construction
+class trace_record_t {
+public:
+    trace_record_t& u(uint64_t v);
+    trace_record_t& s(int64_t v);
+    trace_record_t& str(std::wstring_view v);
+    trace_record_t& rect(const rect_t& r);
+    trace_record_t& handle(const void* h)
+    {
+        return u(reinterpret_cast<uintptr_t>(h));
+    }
+
+    const std::string& bytes() const { return _bytes; }
+
+private:
+    std::string _bytes;
+};
+
+class trace_writer_t {
+public:
+    static std::unique_ptr<trace_writer_t> open(const std::string& path);
+
+    // takes ownership of `f`
+    explicit trace_writer_t(FILE* f);
+    ~trace_writer_t();
+
+    // us since the trace started
+    uint64_t now() const;
+
+    // safe to call from any thread, the duration is taken from now()
+    void write(uint8_t op, uint64_t start, const trace_record_t& rec);
+    void flush();
+
+private:
+    void flush_locked();
+
+    FILE* _f;
+    std::chrono::steady_clock::time_point _t0;
+    std::mutex _mutex;
+    std::string _buffer;
+};
+
+struct trace_entry_t {
+    uint8_t op;
+    uint64_t start;
+    uint64_t duration;
+    const uint8_t* data;
+    size_t size;
+};
+
+// a loaded trace
+class trace_t {
+public:
+    bool load(const std::string& path);
+    const std::vector<trace_entry_t>& entries() const { return _entries; }
+
+private:
+    std::vector<uint8_t> _bytes;
+    std::vector<trace_entry_t> _entries;
+};
+
+// decodes a payload, reading past its end yields zeros and clears ok()
+class trace_cursor_t {
+public:
+    explicit trace_cursor_t(const trace_entry_t& e)
+        : _p(e.data), _end(e.data + e.size), _ok(true)
+    {}
+
+    uint64_t u();
+    int64_t s();
+    void str(std::wstring& out);
+    rect_t rect();
+    template<typename T>
+    T handle()
+    {
+        return reinterpret_cast<T>(static_cast<uintptr_t>(u()));
+    }
+
+    bool ok() const { return _ok; }
+    const uint8_t* position() const { return _p; }
+
+private:
+    const uint8_t* _p;
+    const uint8_t* _end;
+    bool _ok;
+};
+
+// forwards to the real window system and records every call
+class recording_winsys_t : public winsys_t {
+public:
+    recording_winsys_t(winsys_t& ws, trace_writer_t& trace)
+        : _ws(ws), _trace(trace)
+    {}
+
+    void enum_monitors(std::vector<hmonitor_t>& out) override;
+    bool monitor_info(hmonitor_t hmon, monitor_info_t& info) override;
+    hmonitor_t cursor_monitor() override;
+
+    void enum_windows(std::vector<hwnd_t>& out) override;
+    hwnd_t shell_window() override;
+    bool is_window(hwnd_t hwnd) override;
+    bool is_visible(hwnd_t hwnd) override;
+    int title_length(hwnd_t hwnd) override;
+    void title(hwnd_t hwnd, std::wstring& out) override;
+    hmonitor_t window_monitor(hwnd_t hwnd) override;
+    bool window_rect(hwnd_t hwnd, rect_t& r) override;
+    window_show_t window_show_state(hwnd_t hwnd) override;
+    void window_class(hwnd_t hwnd, std::wstring& out) override;
+    uint32_t window_process(hwnd_t hwnd) override;
+
+    void show_window(hwnd_t hwnd, bool show) override;
+    bool cloak_window(hwnd_t hwnd, bool cloak) override;
+    void move_window(hwnd_t hwnd, const rect_t& r) override;
+    void close_window(hwnd_t hwnd) override;
+
+    hwnd_t foreground_window() override;
+    void restack_windows(const std::vector<hwnd_t>& windows, hwnd_t focus) override;
+
+    void process_name(uint32_t pid, std::wstring& out) override;
+    bool process_usage(uint32_t pid, process_usage_t& out) override;
+    bool throttle_process(uint32_t pid, bool throttle, bool trim) override;
+
+private:
+    winsys_t& _ws;
+    trace_writer_t& _trace;
+};
+
+// answers window system calls from a trace
+//
+// calls are matched by operation and first handle (or process id) argument: the n-th call of
+// is_visible(hwnd) gets the n-th recorded answer for that window (and the
+// last one once they run out), so the replay tolerates the reordering
+// parallel scans cause. calls the trace has no answer for at all are
+// counted as misses and answered with nothing / false / 0.
+class replay_winsys_t : public winsys_t {
+public:
+    // with `realtime` every call takes as long as it took when recorded
+    replay_winsys_t(const trace_t& trace, bool realtime);
+
+    // start over from the first recorded answer
+    void rewind();
+
+    size_t calls() const { return _calls; }
+    size_t misses() const { return _misses; }
+
+    void enum_monitors(std::vector<hmonitor_t>& out) override;
+    bool monitor_info(hmonitor_t hmon, monitor_info_t& info) override;
+    hmonitor_t cursor_monitor() override;
+
+    void enum_windows(std::vector<hwnd_t>& out) override;
+    hwnd_t shell_window() override;
+    bool is_window(hwnd_t hwnd) override;
+    bool is_visible(hwnd_t hwnd) override;
+    int title_length(hwnd_t hwnd) override;
+    void title(hwnd_t hwnd, std::wstring& out) override;
+    hmonitor_t window_monitor(hwnd_t hwnd) override;
+    bool window_rect(hwnd_t hwnd, rect_t& r) override;
+    window_show_t window_show_state(hwnd_t hwnd) override;
+    void window_class(hwnd_t hwnd, std::wstring& out) override;
+    uint32_t window_process(hwnd_t hwnd) override;
+
+    void show_window(hwnd_t hwnd, bool show) override;
+    bool cloak_window(hwnd_t hwnd, bool cloak) override;
+    void move_window(hwnd_t hwnd, const rect_t& r) override;
+    void close_window(hwnd_t hwnd) override;
+
+    hwnd_t foreground_window() override;
+    void restack_windows(const std::vector<hwnd_t>& windows, hwnd_t focus) override;
+
+    void process_name(uint32_t pid, std::wstring& out) override;
+    bool process_usage(uint32_t pid, process_usage_t& out) override;
+    bool throttle_process(uint32_t pid, bool throttle, bool trim) override;
+
+private:
+    struct queue_t {
+        std::vector<const trace_entry_t*> entries;
+        size_t next = 0;
+    };
+    typedef std::pair<uint8_t, uint64_t> key_t;
+
+    // the recorded call to answer with, or nullptr
+    const trace_entry_t* next(uint8_t op, const void* handle);
+
+    bool _realtime;
+    std::mutex _mutex;
+    std::map<key_t, queue_t> _queues;
+    size_t _calls = 0;
+    size_t _misses = 0;
+};
+
+#endif // _LIBTTWWAM_TRACE_H_
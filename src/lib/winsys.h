@@ -0,0 +1,102 @@
+#ifndef _LIBTTWWAM_WINSYS_H_
+#define _LIBTTWWAM_WINSYS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the very same types as the (STRICT) win32 handles, without windows.h
+struct HWND__;
+struct HMONITOR__;
+typedef HWND__* hwnd_t;
+typedef HMONITOR__* hmonitor_t;
+
+struct rect_t {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+struct monitor_info_t {
+    rect_t rect;
+    rect_t work;
+    // \\.\DISPLAYn, renumbered when displays come and go
+    std::wstring device;
+    // device interface path of the screen, stable across display changes
+    // (if the driver provides one)
+    std::wstring path;
+    uint32_t dpi;
+};
+
+enum window_show_t : uint8_t {
+    WINDOW_NORMAL,
+    WINDOW_MINIMIZED,
+    WINDOW_MAXIMIZED,
+};
+
+struct process_usage_t {
+    // user and kernel time
+    uint64_t cpu_us;
+    uint64_t working_set;
+};
+
+// how windows of hidden containers are taken off screen
+enum hide_strategy_t : uint8_t {
+    // ShowWindow(SW_HIDE), apps notice and may tear down and re-render
+    HIDE_SHOW_WINDOW,
+    // cloaked by the compositor, the window stays "visible" to its app.
+    // DWM only lets a process cloak its own windows, so for the windows of
+    // other apps (all managed windows) it's refused and falls back to hiding.
+    HIDE_CLOAK,
+    HIDE_STRATEGIES,
+};
+
+// everything the core needs from the window system
+//
+// implemented by the win32 frontend, by the trace recorder wrapping it and
+// by the trace replay. implementations must be callable from any thread.
+class winsys_t {
+public:
+    virtual ~winsys_t() {}
+
+    virtual void enum_monitors(std::vector<hmonitor_t>& out) = 0;
+    virtual bool monitor_info(hmonitor_t hmon, monitor_info_t& info) = 0;
+    virtual hmonitor_t cursor_monitor() = 0;
+
+    virtual void enum_windows(std::vector<hwnd_t>& out) = 0;
+    virtual hwnd_t shell_window() = 0;
+    // false once the window is destroyed
+    virtual bool is_window(hwnd_t hwnd) = 0;
+    // cloaked windows don't count as visible
+    virtual bool is_visible(hwnd_t hwnd) = 0;
+    virtual int title_length(hwnd_t hwnd) = 0;
+    // reuses the capacity of `out`
+    virtual void title(hwnd_t hwnd, std::wstring& out) = 0;
+    virtual hmonitor_t window_monitor(hwnd_t hwnd) = 0;
+    virtual bool window_rect(hwnd_t hwnd, rect_t& r) = 0;
+    virtual window_show_t window_show_state(hwnd_t hwnd) = 0;
+    virtual void window_class(hwnd_t hwnd, std::wstring& out) = 0;
+    virtual uint32_t window_process(hwnd_t hwnd) = 0;
+
+    virtual void show_window(hwnd_t hwnd, bool show) = 0;
+    // false if the window system refused
+    virtual bool cloak_window(hwnd_t hwnd, bool cloak) = 0;
+    virtual void move_window(hwnd_t hwnd, const rect_t& r) = 0;
+    virtual void close_window(hwnd_t hwnd) = 0;
+
+    virtual hwnd_t foreground_window() = 0;
+    // stacks `windows` (top to bottom) in one go and activates `focus`
+    virtual void restack_windows(const std::vector<hwnd_t>& windows, hwnd_t focus) = 0;
+
+    // executable name, without its path
+    virtual void process_name(uint32_t pid, std::wstring& out) = 0;
+    virtual bool process_usage(uint32_t pid, process_usage_t& out) = 0;
+    // lowest priority and efficiency mode, or back to what it was before.
+    // `trim` also empties the working set. throttling returns true if either
+    // took effect (efficiency mode doesn't exist before Windows 10), the
+    // process then has to be restored.
+    virtual bool throttle_process(uint32_t pid, bool throttle, bool trim) = 0;
+};
+
+#endif // _LIBTTWWAM_WINSYS_H_
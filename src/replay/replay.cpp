@@ -0,0 +1,361 @@
+// replays a trace recorded with `ttwwam --trace <file>` against the core,
+// without any window system, and reports how long each event took.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "config.h"
+#include "core.h"
+#include "geometry.h"
+#include "history.h"
+#include "idle.h"
+#include "status.h"
+#include "trace.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using std::wstring;
+
+static bool _verbose = false;
+// published into like the real one, so it's part of what's measured
+static status_segment_t _status;
+
+void log_debug(const wchar_t* txt)
+{
+    if (_verbose) {
+        std::fprintf(stderr, "%ls\n", txt);
+    }
+}
+
+void log_info(const wchar_t* txt)
+{
+    if (_verbose) {
+        std::fprintf(stderr, "  %ls\n", txt);
+    }
+}
+
+void clear_preview()
+{
+}
+
+struct stats_t {
+    vector<double> replayed;
+    double recorded = 0;
+    size_t allocations = 0;
+};
+
+static void usage(const char* argv0)
+{
+    std::fprintf(stderr,
+            "usage: %s [-n iterations] [--soak iterations] [--realtime] [--config file] [-v] <trace>\n"
+            "       %s --bench-geometry\n"
+            "  -n          replay the whole trace that many times (default 1)\n"
+            "  --soak      like -n but keeps the state between iterations and fails\n"
+            "              if the heap grew after the first one\n"
+            "  --realtime  window system calls take as long as they did\n"
+            "  --config    scan with the ignore rules of that configuration, prints how\n"
+            "              long loading it took, parsed and from its cache\n"
+            "  -v          print the log and preview output\n"
+            "  --bench-geometry  compares the vectorized rect conversions with the\n"
+            "              scalar ones and times both\n",
+            argv0, argv0);
+}
+
+static double percentile(vector<double> v, double p)
+{
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+// replays a single event, returns false if it isn't one that can be replayed
+static bool replay_event(const trace_entry_t& e)
+{
+    trace_cursor_t c(e);
+    wstring arg;
+    switch (e.op) {
+        case TRACE_SCAN:
+            scan_current_desktops();
+            return true;
+        case TRACE_BUILD:
+            publish_snapshot(build_snapshot());
+            return true;
+        case TRACE_APPLY:
+            apply_latest_snapshot();
+            return true;
+        case TRACE_SWITCH:
+            {
+                c.str(arg);
+                bool scan = c.u() != 0;
+                arena_scope_t scope(_arena);
+                switch_to_desktop(arg, scan);
+            }
+            return true;
+        case TRACE_PREVIEW:
+            {
+                c.str(arg);
+                arena_scope_t scope(_arena);
+                preview_containers(arg);
+            }
+            return true;
+        case TRACE_DISPLAY_CHANGE:
+            display_changed();
+            return true;
+        case TRACE_UNDO:
+            undo_layout();
+            return true;
+        case TRACE_REDO:
+            redo_layout();
+            return true;
+        case TRACE_MOVE:
+            {
+                wstring pattern;
+                c.str(arg);
+                const window_match_t match = static_cast<window_match_t>(c.u());
+                c.str(pattern);
+                move_windows(match, pattern, arg);
+            }
+            return true;
+        case TRACE_IDLE:
+            c.str(arg);
+            return run_idle_step(arg);
+    }
+    return false;
+}
+
+static void print_config_stats(const char* path)
+{
+    const config_load_stats_t& st = _config_stats;
+    std::printf("config: %s %s, mapped in %.1f us, decoded in %.1f us, parsed in %.1f us, "
+            "swapped in %.1f us, %zu errors\n",
+            path, st.from_cache ? "from its cache" : "parsed", st.map_us, st.decode_us, st.parse_us,
+            st.swap_us, st.errors.size());
+}
+
+// best of `reps` runs of `f`, in us
+template<typename F>
+static double best_us(int reps, F f)
+{
+    double best = 0;
+    for(int i = 0; i < reps; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        best = i ? std::min(best, us) : us;
+    }
+    return best;
+}
+
+template<typename In, typename Out>
+static bool bench_transform(const char* what, const rect_array_t<In>& in, const rect_transform_t& t)
+{
+    rect_array_t<Out> vec;
+    rect_array_t<Out> scalar;
+    const double vec_us = best_us(50, [&] { transform_rects(in, t, vec); });
+    const double scalar_us = best_us(50, [&] { transform_rects_scalar(in, t, scalar); });
+    const bool same = vec.left == scalar.left && vec.top == scalar.top
+        && vec.right == scalar.right && vec.bottom == scalar.bottom;
+    std::printf("%-20s %8zu %12.1f %12.1f %8s\n", what, in.size(), vec_us, scalar_us, same ? "same" : "DIFFERENT");
+    return same;
+}
+
+// absolute -> relative and back for 10k rects on a monitor left of the
+// primary one, where the origin is negative
+static int bench_geometry()
+{
+    const rect_t monitor = {-2560, -200, 0, 1240};
+    rect_array_t<int32_t> absolute;
+    for(int32_t i = 0; i < 10000; ++i) {
+        const int32_t l = monitor.left + (i * 37) % 2500;
+        const int32_t t = monitor.top + (i * 53) % 1400;
+        absolute.push_back(l, t, l + 200 + i % 900, t + 150 + i % 700);
+    }
+    rect_array_t<double> relative;
+    transform_rects_scalar(absolute, relative_to(monitor), relative);
+
+#ifdef TTWWAM_SSE2
+    std::printf("%-20s %8s %12s %12s %8s\n", "conversion", "rects", "sse2 us", "scalar us", "results");
+#else
+    std::printf("%-20s %8s %12s %12s %8s\n", "conversion", "rects", "vector us", "scalar us", "results");
+#endif
+    bool same = bench_transform<int32_t, double>("to relative", absolute, relative_to(monitor));
+    same = bench_transform<double, int32_t>("to absolute", relative, absolute_on(monitor)) && same;
+    same = bench_transform<double, double>("relative rescale", relative, {0.5, 0.25, 0.5, 0.25}) && same;
+    return same ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 2 && !std::strcmp(argv[1], "--bench-geometry")) {
+        return bench_geometry();
+    }
+
+    int iterations = 1;
+    bool realtime = false;
+    bool soak = false;
+    const char* path = nullptr;
+    const char* config = nullptr;
+    for(int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--soak") && i + 1 < argc) {
+            iterations = std::atoi(argv[++i]);
+            soak = true;
+        } else if (!std::strcmp(argv[i], "--config") && i + 1 < argc) {
+            config = argv[++i];
+        } else if (!std::strcmp(argv[i], "--realtime")) {
+            realtime = true;
+        } else if (!std::strcmp(argv[i], "-v")) {
+            _verbose = true;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path || iterations < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    trace_t trace;
+    if (!trace.load(path)) {
+        std::fprintf(stderr, "%s: not a trace (or a different version)\n", path);
+        return 1;
+    }
+
+    if (config) {
+        // the first load writes the cache unless it was there already,
+        // the second one maps it
+        for(int i = 0; i < 2; ++i) {
+            reload_config(config, _config_stats);
+            print_config_stats(config);
+        }
+    }
+
+    vector<const trace_entry_t*> events;
+    size_t calls = 0;
+    for(const auto& e: trace.entries()) {
+        if (e.op >= TRACE_EVENT_BASE) {
+            events.push_back(&e);
+        } else {
+            ++calls;
+        }
+    }
+    // events are written when they end, replay them in the order they began
+    std::stable_sort(events.begin(), events.end(), [](const trace_entry_t* a, const trace_entry_t* b) {
+        return a->start < b->start;
+    });
+
+    replay_winsys_t ws(trace, realtime);
+    core_init(&ws, nullptr);
+    status_attach(&_status);
+    alloc_tracking(true);
+
+    map<uint8_t, stats_t> stats;
+    size_t misses = 0;
+    layout_stats_t layout;
+    size_t warm_bytes = 0;
+    for(int it = 0; it < iterations; ++it) {
+        // a soak keeps everything the first iteration built up
+        if (!soak || !it) {
+            core_reset();
+        }
+        ws.rewind();
+        for(const trace_entry_t* e: events) {
+            size_t allocations = heap_allocations();
+            auto t0 = std::chrono::steady_clock::now();
+            bool replayed = replay_event(*e);
+            auto t1 = std::chrono::steady_clock::now();
+            stats_t& st = stats[e->op];
+            if (!it) {
+                st.recorded += static_cast<double>(e->duration);
+            }
+            if (replayed) {
+                st.replayed.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                st.allocations += heap_allocations() - allocations;
+            }
+        }
+        misses += ws.misses();
+        if (soak) {
+            // never reset, it's the total already
+            layout = layout_stats_t();
+        }
+        layout.shown += _layout_total.shown;
+        layout.hidden += _layout_total.hidden;
+        layout.moved += _layout_total.moved;
+        layout.skipped += _layout_total.skipped;
+        if (!it) {
+            warm_bytes = heap_live_bytes();
+        }
+    }
+    size_t live_bytes = heap_live_bytes();
+
+    std::printf("%s: %zu window system calls, %zu events, %d iteration(s), %zu unanswered calls\n",
+            path, calls, events.size(), iterations, misses);
+    std::printf("%-10s %8s %12s %12s %12s %12s %12s %10s\n",
+            "event", "count", "recorded us", "mean us", "p50 us", "p99 us", "max us", "allocs");
+    for(const auto& it: stats) {
+        const stats_t& st = it.second;
+        size_t n = st.replayed.size();
+        double total = 0;
+        for(double d: st.replayed) {
+            total += d;
+        }
+        size_t recorded_count = n ? n / iterations : 0;
+        std::printf("%-10s %8zu %12.1f %12.1f %12.1f %12.1f %12.1f %10.1f\n",
+                trace_op_name(it.first),
+                recorded_count,
+                recorded_count ? st.recorded / recorded_count : 0.0,
+                n ? total / n : 0.0,
+                percentile(st.replayed, 0.5),
+                percentile(st.replayed, 0.99),
+                percentile(st.replayed, 1.0),
+                n ? static_cast<double>(st.allocations) / n : 0.0);
+    }
+    std::printf("layout: %zu shown, %zu hidden, %zu moved, %zu skipped as no-ops\n",
+            layout.shown, layout.hidden, layout.moved, layout.skipped);
+    // of the last iteration
+    for(int i = 0; i < HIDE_STRATEGIES; ++i) {
+        const hide_stats_t& st = _hide_stats[i];
+        std::printf("%-5ls %8zu windows hidden or shown, %.1f us on average, %.1f us max\n",
+                hide_strategy_name(static_cast<hide_strategy_t>(i)), st.calls,
+                st.calls ? st.total_us / st.calls : 0.0, st.max_us);
+    }
+    // since the last core_reset(), all of them for a soak
+    std::printf("history: %zu versions recorded, %zu kept, %.1f bytes per version, "
+            "%zu restored, last restore %.1f us\n",
+            _history_stats.recorded, history_size(),
+            history_size() ? static_cast<double>(history_bytes()) / history_size() : 0.0,
+            _history_stats.restored, _history_stats.last_restore_us);
+    std::printf("%-20s %8s %12s %12s %10s\n", "scope", "calls", "allocs/call", "bytes/call", "max");
+    for(const auto& st: alloc_stats()) {
+        std::printf("%-20s %8zu %12.1f %12.1f %10zu\n", st.name.c_str(), st.calls,
+                st.calls ? static_cast<double>(st.allocations) / st.calls : 0.0,
+                st.calls ? static_cast<double>(st.bytes) / st.calls : 0.0,
+                st.max_allocations);
+    }
+    if (soak) {
+        // some slack for containers that haven't settled on their capacity yet
+        const size_t slack = 64 * 1024;
+        std::printf("heap: %zu bytes live after the first iteration, %zu after the last\n", warm_bytes, live_bytes);
+        if (live_bytes > warm_bytes + slack) {
+            std::printf("heap grew by %zu bytes over %d iterations\n", live_bytes - warm_bytes, iterations - 1);
+            return 1;
+        }
+        std::printf("heap stayed flat\n");
+    }
+    return 0;
+}
@@ -0,0 +1,285 @@
+#ifndef _TTWWAM_FAKE_WINSYS_H_
+#define _TTWWAM_FAKE_WINSYS_H_
+
+// an in-memory window system for the tests of the core: monitors side by
+// side, windows stacked in the order they were added (the last one on
+// top), every call counted by its trace operation. cloaking is refused like
+// DWM does for windows of other processes.
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+#include "winsys.h"
+
+struct fake_window_t {
+    hmonitor_t hmon = nullptr;
+    rect_t rect = {};
+    std::wstring title;
+    std::wstring cls;
+    uint32_t pid = 0;
+    bool visible = true;
+};
+
+class fake_winsys_t : public winsys_t {
+public:
+    hmonitor_t add_monitor(int32_t width, int32_t height)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        hmonitor_t hmon = reinterpret_cast<hmonitor_t>(static_cast<uintptr_t>(0x100 * (_monitors.size() + 1)));
+        monitor_info_t info;
+        info.rect = {_right, 0, _right + width, height};
+        info.work = info.rect;
+        info.device = L"\\\\.\\DISPLAY" + std::to_wstring(_monitors.size() + 1);
+        info.dpi = 96;
+        _monitors[hmon] = info;
+        _right += width;
+        return hmon;
+    }
+
+    // on top of the others, at `r` relative to the monitor
+    hwnd_t add_window(hmonitor_t hmon, const std::wstring& title, const std::wstring& cls, uint32_t pid,
+            rect_t r = {100, 100, 900, 700})
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        hwnd_t hwnd = reinterpret_cast<hwnd_t>(static_cast<uintptr_t>(0x10000 + 0x10 * ++_next_window));
+        const rect_t& m = _monitors[hmon].rect;
+        fake_window_t& w = _windows[hwnd];
+        w.hmon = hmon;
+        w.rect = {m.left + r.left, m.top + r.top, m.left + r.right, m.top + r.bottom};
+        w.title = title;
+        w.cls = cls;
+        w.pid = pid;
+        _stack.insert(_stack.begin(), hwnd);
+        return hwnd;
+    }
+
+    void destroy(hwnd_t hwnd)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _windows.erase(hwnd);
+        _stack.erase(std::remove(_stack.begin(), _stack.end(), hwnd), _stack.end());
+    }
+
+    fake_window_t window(hwnd_t hwnd)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _windows[hwnd];
+    }
+
+    void set_foreground(hwnd_t hwnd)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _foreground = hwnd;
+    }
+
+    // the processes throttled right now
+    bool throttled(uint32_t pid)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _throttled[pid];
+    }
+
+    size_t calls(trace_op_t op)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _calls[op];
+    }
+
+    void reset_calls()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _calls.clear();
+    }
+
+    void enum_monitors(std::vector<hmonitor_t>& out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_ENUM_MONITORS];
+        out.clear();
+        for(const auto& m: _monitors) {
+            out.push_back(m.first);
+        }
+    }
+
+    bool monitor_info(hmonitor_t hmon, monitor_info_t& info) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_MONITOR_INFO];
+        auto it = _monitors.find(hmon);
+        if (it == _monitors.end()) {
+            return false;
+        }
+        info = it->second;
+        return true;
+    }
+
+    hmonitor_t cursor_monitor() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_CURSOR_MONITOR];
+        return _monitors.empty() ? nullptr : _monitors.begin()->first;
+    }
+
+    void enum_windows(std::vector<hwnd_t>& out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_ENUM_WINDOWS];
+        out = _stack;
+    }
+
+    hwnd_t shell_window() override
+    {
+        return nullptr;
+    }
+
+    bool is_window(hwnd_t hwnd) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_IS_WINDOW];
+        return _windows.find(hwnd) != _windows.end();
+    }
+
+    bool is_visible(hwnd_t hwnd) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _windows.find(hwnd);
+        return it != _windows.end() && it->second.visible;
+    }
+
+    int title_length(hwnd_t hwnd) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _windows.find(hwnd);
+        return it != _windows.end() ? static_cast<int>(it->second.title.size()) : 0;
+    }
+
+    void title(hwnd_t hwnd, std::wstring& out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        out = _windows[hwnd].title;
+    }
+
+    hmonitor_t window_monitor(hwnd_t hwnd) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _windows[hwnd].hmon;
+    }
+
+    bool window_rect(hwnd_t hwnd, rect_t& r) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        r = _windows[hwnd].rect;
+        return true;
+    }
+
+    window_show_t window_show_state(hwnd_t) override
+    {
+        return WINDOW_NORMAL;
+    }
+
+    void window_class(hwnd_t hwnd, std::wstring& out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        out = _windows[hwnd].cls;
+    }
+
+    uint32_t window_process(hwnd_t hwnd) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _windows[hwnd].pid;
+    }
+
+    void show_window(hwnd_t hwnd, bool show) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_SHOW_WINDOW];
+        _windows[hwnd].visible = show;
+    }
+
+    bool cloak_window(hwnd_t, bool) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_CLOAK_WINDOW];
+        return false;
+    }
+
+    // the window ends up on the monitor its top left corner is on
+    void move_window(hwnd_t hwnd, const rect_t& r) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_MOVE_WINDOW];
+        fake_window_t& w = _windows[hwnd];
+        w.rect = r;
+        for(const auto& m: _monitors) {
+            if (r.left >= m.second.rect.left && r.left < m.second.rect.right) {
+                w.hmon = m.first;
+            }
+        }
+    }
+
+    void close_window(hwnd_t) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_CLOSE_WINDOW];
+    }
+
+    hwnd_t foreground_window() override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_FOREGROUND_WINDOW];
+        return _foreground;
+    }
+
+    void restack_windows(const std::vector<hwnd_t>& windows, hwnd_t focus) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_RESTACK_WINDOWS];
+        for(auto it = windows.rbegin(); it != windows.rend(); ++it) {
+            _stack.erase(std::remove(_stack.begin(), _stack.end(), *it), _stack.end());
+            _stack.insert(_stack.begin(), *it);
+        }
+        if (focus) {
+            _foreground = focus;
+        }
+    }
+
+    void process_name(uint32_t pid, std::wstring& out) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_PROCESS_NAME];
+        out = L"app" + std::to_wstring(pid) + L".exe";
+    }
+
+    bool process_usage(uint32_t, process_usage_t& out) override
+    {
+        out = process_usage_t{0, 0};
+        return true;
+    }
+
+    bool throttle_process(uint32_t pid, bool throttle, bool) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_calls[TRACE_THROTTLE_PROCESS];
+        _throttled[pid] = throttle;
+        return true;
+    }
+
+private:
+    std::mutex _mutex;
+    std::map<hmonitor_t, monitor_info_t> _monitors;
+    int32_t _right = 0;
+    std::map<hwnd_t, fake_window_t> _windows;
+    // top to bottom
+    std::vector<hwnd_t> _stack;
+    size_t _next_window = 0;
+    hwnd_t _foreground = nullptr;
+    std::map<uint32_t, bool> _throttled;
+    std::map<uint8_t, size_t> _calls;
+};
+
+#endif // _TTWWAM_FAKE_WINSYS_H_
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+struct registered_t {
+    const char* group;
+    const char* name;
+    test_func_t func;
+};
+
+static std::vector<registered_t>& registry()
+{
+    static std::vector<registered_t> cases;
+    return cases;
+}
+
+static size_t _failures = 0;
+
+test_case_t::test_case_t(const char* group, const char* name, test_func_t func)
+{
+    registry().push_back({group, name, func});
+}
+
+void test_failed(const char* file, int line, const char* expr)
+{
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+    ++_failures;
+}
+
+// the frontend's part of core.h, nothing to show here
+void log_debug(const wchar_t*)
+{
+}
+
+void log_info(const wchar_t*)
+{
+}
+
+void clear_preview()
+{
+}
+
+int main(int argc, char** argv)
+{
+    const char* group = argc > 1 ? argv[1] : nullptr;
+    size_t ran = 0;
+    for(const auto& t: registry()) {
+        if (group && std::strcmp(group, t.group)) {
+            continue;
+        }
+        const size_t before = _failures;
+        t.func();
+        std::printf("%-8s %s.%s\n", _failures == before ? "ok" : "FAILED", t.group, t.name);
+        ++ran;
+    }
+    if (!ran) {
+        std::fprintf(stderr, "no tests in group %s\n", group ? group : "(all)");
+        return 2;
+    }
+    return _failures ? 1 : 0;
+}
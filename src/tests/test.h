@@ -0,0 +1,30 @@
+#ifndef _TTWWAM_TEST_H_
+#define _TTWWAM_TEST_H_
+
+// a minimal harness for the portable core: TEST(group, name) registers a
+// case, CHECK() reports a failed expression and carries on. ttwwam-tests
+// runs the cases of the group given on the command line, or all of them.
+
+#include <cstddef>
+
+typedef void (*test_func_t)();
+
+struct test_case_t {
+    test_case_t(const char* group, const char* name, test_func_t func);
+};
+
+void test_failed(const char* file, int line, const char* expr);
+
+#define TEST(group, name) \
+    static void test_##group##_##name(); \
+    static test_case_t _test_case_##group##_##name(#group, #name, test_##group##_##name); \
+    static void test_##group##_##name()
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            test_failed(__FILE__, __LINE__, #expr); \
+        } \
+    } while (0)
+
+#endif // _TTWWAM_TEST_H_
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "cmdlog.h"
+#include "test.h"
+
+namespace fs = std::filesystem;
+
+// a fresh directory per case, removed again when it's done
+struct scratch_dir_t {
+    fs::path path;
+
+    explicit scratch_dir_t(const char* name)
+        : path(fs::temp_directory_path() / (std::string("ttwwam-test-") + name))
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+        fs::create_directories(path);
+    }
+
+    ~scratch_dir_t()
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+// entries written are mapped back in, in order
+TEST(cmdlog, round_trip)
+{
+    scratch_dir_t dir("cmdlog-round-trip");
+    const fs::path file = dir.path / "history";
+    {
+        command_log_t log;
+        log.open(file, {});
+        log.append(L"web");
+        log.append(L":move mail title inbox");
+        log.append(L":move mail title inbox");
+        log.append(L"");
+        log.append(L"café über");
+        CHECK(log.size() == 3);
+        CHECK(log.stats().appended == 3);
+    }
+
+    command_log_t log;
+    log.open(file, {});
+    CHECK(log.stats().loaded == 3);
+    CHECK(log.size() == 3);
+    CHECK(log.at(0) == L"web");
+    CHECK(log.at(1) == L":move mail title inbox");
+    CHECK(log.at(2) == L"café über");
+    CHECK(log.stats().file_bytes == fs::file_size(file));
+
+    CHECK(log.search(L"mail", log.size()) == 1);
+    CHECK(log.search(L"w", 1) == 0);
+    CHECK(log.search(L"nothing", log.size()) == log.size());
+}
+
+// a torn last record is cut off, everything before it survives
+TEST(cmdlog, torn_write)
+{
+    scratch_dir_t dir("cmdlog-torn");
+    const fs::path file = dir.path / "history";
+    {
+        command_log_t log;
+        log.open(file, {});
+        log.append(L"first");
+        log.append(L"second");
+    }
+    const uintmax_t intact = fs::file_size(file);
+    fs::resize_file(file, intact - 2);
+
+    {
+        command_log_t log;
+        log.open(file, {});
+        CHECK(log.size() == 1);
+        CHECK(log.at(0) == L"first");
+        log.append(L"third");
+    }
+    command_log_t log;
+    log.open(file, {});
+    CHECK(log.size() == 2);
+    CHECK(log.at(1) == L"third");
+}
+
+// not a log at all, started over
+TEST(cmdlog, foreign_file)
+{
+    scratch_dir_t dir("cmdlog-foreign");
+    const fs::path file = dir.path / "history";
+    std::ofstream(file) << "not a history";
+
+    command_log_t log;
+    log.open(file, {});
+    CHECK(log.size() == 0);
+    log.append(L"x");
+    log.close();
+    log.open(file, {});
+    CHECK(log.size() == 1);
+}
+
+// compaction keeps the newest occurrence of each command, plus what got
+// appended while it ran
+TEST(cmdlog, compaction)
+{
+    scratch_dir_t dir("cmdlog-compaction");
+    const fs::path file = dir.path / "history";
+    {
+        command_log_t log;
+        log.open(file, {});
+        for(size_t i = 0; i < CMDLOG_COMPACT_EVERY; ++i) {
+            log.append(i % 2 ? L"a" : L"b");
+        }
+        CHECK(log.compaction_due());
+    }
+
+    std::atomic<bool> compacted{false};
+    command_log_t log;
+    // open() compacts right away
+    log.open(file, [&compacted] { compacted = true; });
+    log.append(L"c");
+    while (!compacted) {
+        std::this_thread::yield();
+    }
+    log.finish_compaction();
+    CHECK(!log.compaction_due());
+    CHECK(log.stats().compactions == 1);
+    CHECK(log.stats().dropped == CMDLOG_COMPACT_EVERY - 2);
+    CHECK(log.size() == 3);
+    CHECK(log.at(0) == L"b");
+    CHECK(log.at(1) == L"a");
+    CHECK(log.at(2) == L"c");
+    log.close();
+    CHECK(!fs::exists(file.string() + ".tmp"));
+
+    log.open(file, {});
+    CHECK(log.size() == 3);
+    CHECK(log.at(2) == L"c");
+}
@@ -0,0 +1,52 @@
+#include <string>
+
+#include "export.h"
+#include "test.h"
+
+// the length in front of the string at `at`, and where the string starts
+static uint64_t string_length(const std::string& buf, size_t& at)
+{
+    uint64_t n = 0;
+    for(int shift = 0;; shift += 7) {
+        const uint8_t b = static_cast<uint8_t>(buf[at++]);
+        n |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return n;
+        }
+    }
+}
+
+// the length is patched in front of the UTF-8 bytes, whatever their number
+TEST(export, binary_strings)
+{
+    const std::wstring ascii(300, L'a');
+    const std::wstring accents(100, L'é');
+    const std::wstring big(100000, L'x');
+    for(const std::wstring* s: {&ascii, &accents, &big}) {
+        export_writer_t out(EXPORT_BINARY);
+        out.str(*s).null();
+        const std::string& buf = out.buffer();
+        size_t at = 5;
+        CHECK(static_cast<uint8_t>(buf[at++]) == EXPORT_TAG_STRING);
+        const uint64_t n = string_length(buf, at);
+        CHECK(at + n + 1 == buf.size());
+        CHECK(static_cast<uint8_t>(buf.back()) == EXPORT_TAG_NULL);
+    }
+
+    export_writer_t out(EXPORT_BINARY);
+    out.str(L"").str(L"café");
+    const std::string& buf = out.buffer();
+    CHECK(buf.substr(5) == std::string("\x09\x00\x09\x05" "caf\xc3\xa9", 9));
+}
+
+// escapes for what JSON can't have raw, lone surrogate halves among them
+TEST(export, json_escapes)
+{
+    std::wstring s = L"a\"b\\c\nd\x01";
+    s.push_back(static_cast<wchar_t>(0xd800));
+    s += L"eé";
+    s.push_back(static_cast<wchar_t>(0xdfff));
+    export_writer_t out(EXPORT_JSON);
+    out.str(s);
+    CHECK(out.buffer() == "\"a\\\"b\\\\c\\nd\\u0001\\ud800e\xc3\xa9\\udfff\"");
+}
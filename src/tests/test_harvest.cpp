@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "core.h"
+#include "fake_winsys.h"
+#include "pool.h"
+#include "test.h"
+
+// a window whose process stops answering: asking for its title blocks
+// until it's released
+class hanging_winsys_t : public fake_winsys_t {
+public:
+    hwnd_t hung = nullptr;
+    std::atomic<size_t> asked{0};
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(_hang_mutex);
+        hung = nullptr;
+        _hang_cv.notify_all();
+    }
+
+    void title(hwnd_t hwnd, std::wstring& out) override
+    {
+        {
+            std::unique_lock<std::mutex> lock(_hang_mutex);
+            if (hwnd == hung) {
+                ++asked;
+                _hang_cv.wait(lock, [this, hwnd] { return hung != hwnd; });
+            }
+        }
+        fake_winsys_t::title(hwnd, out);
+    }
+
+private:
+    std::mutex _hang_mutex;
+    std::condition_variable _hang_cv;
+};
+
+static double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a hung window costs one worker and one deadline, later scans serve it
+// from the previous snapshot without waiting until it answers again
+TEST(harvest, hung_window)
+{
+    hanging_winsys_t ws;
+    hmonitor_t hmon = ws.add_monitor(1920, 1080);
+    hwnd_t stuck = ws.add_window(hmon, L"Stuck", L"StuckWindow", 7);
+    for(int i = 0; i < 10; ++i) {
+        ws.add_window(hmon, L"Window " + std::to_wstring(i), L"Window", 8);
+    }
+    core_init(&ws, nullptr);
+    core_reset();
+    scan_current_desktops();
+    CHECK(current_container()->wmap.size() == 11);
+
+    ws.hung = stuck;
+    auto start = std::chrono::steady_clock::now();
+    scan_current_desktops();
+    CHECK(ms_since(start) >= 100);
+    CHECK(hung_windows() == 1);
+    {
+        rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+        CHECK(snap->stale == 1);
+        CHECK(snap->windows.size() == 11);
+    }
+
+    for(int i = 0; i < 5; ++i) {
+        start = std::chrono::steady_clock::now();
+        scan_current_desktops();
+        CHECK(ms_since(start) < 100);
+        rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+        CHECK(snap->stale == 1);
+    }
+    CHECK(ws.asked == 1);
+    CHECK(current_container()->wmap.count(stuck) == 1);
+
+    ws.release();
+    while (hung_windows()) {
+        std::this_thread::yield();
+    }
+    scan_current_desktops();
+    rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+    CHECK(snap->stale == 0);
+    CHECK(snap->windows.size() == 11);
+}
+
+// with its only thread stuck, the pool refuses jobs beyond its limit
+TEST(harvest, queue_limit)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool go = false;
+    std::atomic<size_t> ran{0};
+    {
+        worker_pool_t pool(1, 4);
+        CHECK(pool.submit([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&go] { return go; });
+            ++ran;
+        }));
+        // the thread took the first one
+        while (pool.queued()) {
+            std::this_thread::yield();
+        }
+        for(int i = 0; i < 4; ++i) {
+            CHECK(pool.submit([&ran] { ++ran; }));
+        }
+        CHECK(!pool.submit([&ran] { ++ran; }));
+        CHECK(pool.queued() == 4);
+        CHECK(pool.refused() == 1);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            go = true;
+        }
+        cv.notify_all();
+    }
+    // the destructor lets the queue drain
+    CHECK(ran == 5);
+}
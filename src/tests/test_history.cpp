@@ -0,0 +1,42 @@
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "fake_winsys.h"
+#include "test.h"
+
+// the containers a version hides keep the focus they had in it, not
+// whatever has the focus while it's restored
+TEST(history, undo_keeps_focus)
+{
+    fake_winsys_t ws;
+    hmonitor_t hmon = ws.add_monitor(1920, 1080);
+    std::vector<hwnd_t> mail;
+    for(int i = 0; i < 5; ++i) {
+        mail.push_back(ws.add_window(hmon, L"Inbox " + std::to_wstring(i), L"MailWindow", 7));
+    }
+    hwnd_t editor = ws.add_window(hmon, L"Editor", L"EditWindow", 8);
+    hwnd_t shell = ws.add_window(hmon, L"Shell", L"ShellWindow", 9);
+    core_init(&ws, nullptr);
+    core_reset();
+    scan_current_desktops();
+
+    CHECK(move_windows(MATCH_CLASS, L"mailwindow", L"mail") == 5);
+    CHECK(switch_to_desktop(L"mail", false));
+    ws.set_foreground(mail[1]);
+    CHECK(switch_to_desktop(L"main", false));
+    CHECK(find_container(L"mail")->focus == mail[1]);
+    CHECK(move_windows(MATCH_CLASS, L"shellwindow", L"shell") == 1);
+
+    ws.set_foreground(editor);
+    ws.reset_calls();
+    CHECK(undo_layout());
+    CHECK(ws.window(shell).visible);
+    CHECK(!ws.window(mail[1]).visible);
+    // the hidden containers weren't enumerated again
+    CHECK(ws.calls(TRACE_ENUM_WINDOWS) == 0);
+    CHECK(find_container(L"mail")->focus == mail[1]);
+
+    CHECK(switch_to_desktop(L"mail", false));
+    CHECK(ws.foreground_window() == mail[1]);
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "idle.h"
+#include "test.h"
+
+typedef std::chrono::steady_clock test_clock_t;
+
+static double us_since(test_clock_t::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(test_clock_t::now() - start).count();
+}
+
+// busy, sleeping could take much longer than asked for
+static void spin_us(unsigned us)
+{
+    const auto start = test_clock_t::now();
+    while (us_since(start) < us) {
+    }
+}
+
+static const idle_job_t* find(const wchar_t* name)
+{
+    for(const auto& j: idle_jobs()) {
+        if (j.name == name) {
+            return &j;
+        }
+    }
+    return nullptr;
+}
+
+// the groups testing the core leave its jobs behind when run in the same
+// process, with the window system they were given gone
+static void remove_all_jobs()
+{
+    std::vector<std::wstring> names;
+    for(const auto& j: idle_jobs()) {
+        names.push_back(j.name);
+    }
+    for(const auto& name: names) {
+        remove_idle_job(name);
+    }
+}
+
+static bool never()
+{
+    return false;
+}
+
+// a turn ends with the first step that crosses the slice, and the job
+// picks up where it stopped on the next one
+TEST(idle, slice)
+{
+    remove_all_jobs();
+    int left = 20;
+    add_idle_job(L"slow", 0, 60000, 2000, [&left] {
+        spin_us(300);
+        return --left ? IDLE_MORE : IDLE_DONE;
+    });
+
+    double longest = 0;
+    size_t turns = 0;
+    while (next_idle_ms() == 0) {
+        const auto start = test_clock_t::now();
+        CHECK(run_idle(never));
+        longest = std::max(longest, us_since(start));
+        ++turns;
+    }
+    const idle_job_t* job = find(L"slow");
+    CHECK(job);
+    CHECK(job->stats.runs == 1);
+    CHECK(job->stats.steps == 20);
+    CHECK(job->stats.sliced == turns - 1);
+    CHECK(turns >= 3);
+    CHECK(job->stats.deferrals == 0);
+    // the slice plus the step that crossed it, and some slack for the loop
+    CHECK(longest <= job->slice_us + job->stats.max_step_us + 500);
+    // done, not due again before its interval
+    CHECK(next_idle_ms() > 50000);
+    remove_idle_job(L"slow");
+    CHECK(next_idle_ms() == -1);
+}
+
+// pending input is checked before every step, including the first
+TEST(idle, input)
+{
+    remove_all_jobs();
+    int steps = 0;
+    add_idle_job(L"job", 0, 60000, 1000000, [&steps] {
+        ++steps;
+        return IDLE_MORE;
+    });
+
+    CHECK(!run_idle([] { return true; }));
+    CHECK(steps == 0);
+    CHECK(find(L"job")->stats.deferrals == 1);
+
+    int asked = 0;
+    CHECK(run_idle([&asked] { return ++asked > 3; }));
+    CHECK(steps == 3);
+    CHECK(find(L"job")->stats.deferrals == 2);
+    CHECK(find(L"job")->stats.runs == 0);
+    // unfinished, so still due
+    CHECK(next_idle_ms() == 0);
+    remove_idle_job(L"job");
+}
+
+// the lowest priority due job goes first, an unfinished one isn't
+// overtaken by one that's less urgent
+TEST(idle, priority)
+{
+    remove_all_jobs();
+    wchar_t order[8] = {};
+    size_t n = 0;
+    add_idle_job(L"low", 5, 60000, 1000, [&] {
+        order[n++] = L'l';
+        return IDLE_DONE;
+    });
+    int high_left = 2;
+    add_idle_job(L"high", 1, 60000, 1000, [&] {
+        order[n++] = L'h';
+        return --high_left ? IDLE_MORE : IDLE_DONE;
+    });
+
+    int asked = 0;
+    // one step, then input
+    run_idle([&asked] { return asked++ > 0; });
+    run_idle(never);
+    run_idle(never);
+    CHECK(std::wstring(order) == L"hhl");
+    CHECK(!run_idle(never));
+
+    // woken before its interval
+    wake_idle_job(L"low");
+    CHECK(next_idle_ms() == 0);
+    run_idle(never);
+    CHECK(std::wstring(order) == L"hhll");
+    remove_idle_job(L"low");
+    remove_idle_job(L"high");
+}
+
+// the replay runs single steps by name, whether they're due or not
+TEST(idle, step_by_name)
+{
+    remove_all_jobs();
+    int steps = 0;
+    add_idle_job(L"named", 0, 60000, 1000, [&steps] {
+        ++steps;
+        return IDLE_DONE;
+    });
+    run_idle(never);
+    CHECK(steps == 1);
+    CHECK(run_idle_step(L"named"));
+    CHECK(steps == 2);
+    CHECK(!run_idle_step(L"unknown"));
+
+    idle_reset();
+    CHECK(find(L"named")->stats.runs == 0);
+    CHECK(next_idle_ms() == 0);
+    remove_idle_job(L"named");
+}
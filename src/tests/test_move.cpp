@@ -0,0 +1,91 @@
+#include "core.h"
+#include "fake_winsys.h"
+#include "test.h"
+
+// two monitors, 50 windows of process 7 and 10 of others on the first one
+struct move_desktop_t {
+    fake_winsys_t ws;
+    hmonitor_t left;
+    hmonitor_t right;
+    std::vector<hwnd_t> mail;
+
+    move_desktop_t()
+    {
+        left = ws.add_monitor(1920, 1080);
+        right = ws.add_monitor(1920, 1080);
+        for(int i = 0; i < 50; ++i) {
+            mail.push_back(ws.add_window(left, L"Inbox " + std::to_wstring(i), L"MailWindow", 7,
+                    {10 * i, 10 * i, 10 * i + 800, 10 * i + 600}));
+        }
+        for(int i = 0; i < 10; ++i) {
+            ws.add_window(left, L"Editor " + std::to_wstring(i), L"EditWindow", 100 + i);
+        }
+        core_init(&ws, nullptr);
+        core_reset();
+        scan_current_desktops();
+    }
+};
+
+static size_t shown(fake_winsys_t& ws, const std::vector<hwnd_t>& windows)
+{
+    size_t n = 0;
+    for(hwnd_t hwnd: windows) {
+        n += ws.window(hwnd).visible;
+    }
+    return n;
+}
+
+// into a new, hidden container: a single commit without rescans
+TEST(move, into_hidden)
+{
+    move_desktop_t d;
+    CHECK(current_container()->wmap.size() == 60);
+    d.ws.reset_calls();
+
+    CHECK(move_windows(MATCH_PROCESS, L"APP7", L"mail") == 50);
+    CHECK(d.ws.calls(TRACE_ENUM_WINDOWS) == 0);
+    CHECK(d.ws.calls(TRACE_MOVE_WINDOW) == 0);
+    // one ShowWindow each, process names looked up once per process
+    CHECK(d.ws.calls(TRACE_SHOW_WINDOW) == 50);
+    CHECK(d.ws.calls(TRACE_PROCESS_NAME) <= 11);
+    CHECK(shown(d.ws, d.mail) == 0);
+    CHECK(find_container(L"mail")->wmap.size() == 50);
+    CHECK(current_container()->wmap.size() == 10);
+
+    // one layout change, one undo brings all of them back
+    CHECK(undo_layout());
+    CHECK(shown(d.ws, d.mail) == 50);
+    CHECK(current_container()->wmap.size() == 60);
+}
+
+// onto the container shown on the other monitor, placed relative to it
+TEST(move, onto_other_monitor)
+{
+    move_desktop_t d;
+    std::shared_ptr<container_t> other = new_container(L"right");
+    CHECK(move_to_monitor(other, d.right));
+    d.ws.reset_calls();
+
+    CHECK(move_windows(MATCH_CLASS, L"mailwindow", L"right") == 50);
+    CHECK(d.ws.calls(TRACE_ENUM_WINDOWS) == 0);
+    CHECK(d.ws.calls(TRACE_MOVE_WINDOW) == 50);
+    CHECK(shown(d.ws, d.mail) == 50);
+    for(size_t i = 0; i < d.mail.size(); ++i) {
+        const fake_window_t w = d.ws.window(d.mail[i]);
+        CHECK(w.hmon == d.right);
+        CHECK(w.rect.left == 1920 + 10 * static_cast<int32_t>(i));
+        CHECK(w.rect.right - w.rect.left == 800);
+    }
+}
+
+// the focused window only, nothing when nothing matches
+TEST(move, focus)
+{
+    move_desktop_t d;
+    d.ws.set_foreground(d.mail[3]);
+    CHECK(move_windows(MATCH_FOCUS, L"", L"one") == 1);
+    CHECK(find_container(L"one")->wmap.count(d.mail[3]) == 1);
+    CHECK(!d.ws.window(d.mail[3]).visible);
+    CHECK(move_windows(MATCH_TITLE, L"no such title", L"one") == 0);
+    CHECK(move_windows(MATCH_TITLE, L"", L"one") == 0);
+}
@@ -0,0 +1,68 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "fake_winsys.h"
+#include "rcu.h"
+#include "test.h"
+
+// many more readers than slots, each pinning a value for a while: they all
+// get their turn, and every value they see is a whole one
+TEST(rcu, more_readers_than_slots)
+{
+    struct value_t {
+        uint64_t a;
+        uint64_t b;
+    };
+    rcu_cell_t<value_t, 2> cell;
+    cell.publish(std::unique_ptr<value_t>(new value_t{0, 0}));
+
+    std::atomic<size_t> reads{0};
+    std::atomic<size_t> torn{0};
+    std::vector<std::thread> readers;
+    for(int r = 0; r < 16; ++r) {
+        readers.emplace_back([&] {
+            for(int i = 0; i < 2000; ++i) {
+                rcu_cell_t<value_t, 2>::read_t v(cell);
+                torn += v->a != v->b;
+                ++reads;
+            }
+        });
+    }
+    for(uint64_t i = 1; i <= 2000; ++i) {
+        cell.publish(std::unique_ptr<value_t>(new value_t{i, i}));
+    }
+    for(auto& t: readers) {
+        t.join();
+    }
+    CHECK(reads == 16 * 2000);
+    CHECK(torn == 0);
+    // nothing pinned anymore, the next publish frees all of it
+    cell.publish(std::unique_ptr<value_t>(new value_t{0, 0}));
+    CHECK(cell.retired() == 0);
+}
+
+// of two concurrent scans the one that started later wins, even if it
+// finished first
+TEST(rcu, later_scan_wins)
+{
+    fake_winsys_t ws;
+    hmonitor_t hmon = ws.add_monitor(1920, 1080);
+    hwnd_t closed = ws.add_window(hmon, L"Closed", L"Window", 7);
+    core_init(&ws, nullptr);
+    core_reset();
+
+    std::unique_ptr<desktop_snapshot_t> early = build_snapshot();
+    ws.destroy(closed);
+    std::unique_ptr<desktop_snapshot_t> late = build_snapshot();
+    CHECK(early->scan < late->scan);
+    // finished in the opposite order
+    std::swap(early->generation, late->generation);
+
+    publish_snapshot(std::move(late));
+    publish_snapshot(std::move(early));
+    rcu_cell_t<desktop_snapshot_t>::read_t snap(_snapshot);
+    CHECK(snap->windows.empty());
+}
@@ -0,0 +1,40 @@
+#include <string>
+
+#include "arena.h"
+#include "core.h"
+#include "fake_winsys.h"
+#include "history.h"
+#include "test.h"
+
+// three containers of windows on one monitor, switched between thousands
+// of times: once the layout history has wrapped around the heap stays flat
+TEST(soak, switches)
+{
+    fake_winsys_t ws;
+    hmonitor_t hmon = ws.add_monitor(1920, 1080);
+    for(int i = 0; i < 30; ++i) {
+        ws.add_window(hmon, L"Window " + std::to_wstring(i), L"Window" + std::to_wstring(i % 3), 10 + i % 3);
+    }
+    core_init(&ws, nullptr);
+    core_reset();
+    scan_current_desktops();
+    CHECK(move_windows(MATCH_CLASS, L"window1", L"b") == 10);
+    CHECK(move_windows(MATCH_CLASS, L"window2", L"c") == 10);
+
+    const wchar_t* names[] = {L"b", L"c", L"main"};
+    auto run = [&names](size_t n) {
+        for(size_t i = 0; i < n; ++i) {
+            arena_scope_t scope(_arena);
+            CHECK(switch_to_desktop(names[i % 3], i % 50 == 0));
+        }
+    };
+    // every version of the history filled
+    run(4 * HISTORY_VERSIONS);
+    const size_t warm = heap_live_bytes();
+    run(5000);
+    const size_t live = heap_live_bytes();
+    // the same slack as ttwwam-replay --soak
+    CHECK(live <= warm + 64 * 1024);
+    CHECK(find_container(L"b")->wmap.size() == 10);
+    CHECK(find_container(L"c")->wmap.size() == 10);
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "input.h"
+#include "spsc.h"
+#include "test.h"
+
+typedef spsc_queue_t<input_event_t, 256> input_queue_t;
+
+static double us_between(uint64_t from, uint64_t to)
+{
+    return static_cast<double>(to - from);
+}
+
+// the hook's side: `n` hotkeys `gap_us` apart, keys numbered from 1. keeps
+// the longest push, which must never wait for the consumer.
+static void produce(input_queue_t& q, uint32_t n, uint64_t gap_us, size_t& dropped, double& max_push_us)
+{
+    for(uint32_t i = 1; i <= n; ++i) {
+        const uint64_t due = input_now_us() + gap_us;
+        while (input_now_us() < due) {
+        }
+        input_event_t ev = {input_now_us(), 0, i, 0};
+        if (!q.push(ev)) {
+            ++dropped;
+        }
+        max_push_us = std::max(max_push_us, us_between(ev.time_us, input_now_us()));
+    }
+}
+
+// a main thread that's busy for 50ms gets every hotkey pressed meanwhile
+// afterwards, in order, each one as late as the stall made it
+TEST(spsc, stalled_consumer)
+{
+    const uint32_t EVENTS = 200;
+    const uint64_t STALL_US = 50000;
+    input_queue_t q;
+    size_t dropped = 0;
+    double max_push_us = 0;
+    std::thread hook([&] { produce(q, EVENTS, 100, dropped, max_push_us); });
+    std::this_thread::sleep_for(std::chrono::microseconds(STALL_US));
+
+    input_stats_t stats;
+    uint32_t next = 1;
+    while (next <= EVENTS) {
+        input_event_t ev;
+        if (!q.pop(ev)) {
+            continue;
+        }
+        CHECK(ev.key == next);
+        ++next;
+        stats.record(us_between(ev.time_us, input_now_us()));
+    }
+    hook.join();
+
+    CHECK(dropped == 0);
+    CHECK(q.empty());
+    CHECK(stats.dispatched == EVENTS);
+    // the first hotkey waited out the stall, less what it took to press it
+    CHECK(stats.max_us >= static_cast<double>(STALL_US) - 1000);
+    // the hook never waits for the consumer
+    CHECK(max_push_us < 5000);
+}
+
+// a stall longer than the queue lasts refuses what doesn't fit right away,
+// nothing already queued is lost and it takes events again once drained
+TEST(spsc, overflow)
+{
+    input_queue_t q;
+    size_t dropped = 0;
+    double max_push_us = 0;
+    produce(q, 1000, 0, dropped, max_push_us);
+    // one slot stays empty
+    CHECK(dropped == 1000 - 255);
+    CHECK(max_push_us < 5000);
+
+    input_event_t ev;
+    for(uint32_t i = 1; i <= 255; ++i) {
+        CHECK(q.pop(ev));
+        CHECK(ev.key == i);
+    }
+    CHECK(!q.pop(ev));
+    CHECK(q.push(ev));
+}
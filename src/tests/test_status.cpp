@@ -0,0 +1,100 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "status.h"
+#include "test.h"
+
+static std::u16string u16(const std::wstring& s)
+{
+    return std::u16string(s.begin(), s.end());
+}
+
+// the k-th layout: containers "a<k>" and "b<k>", one of them shown on a
+// monitor whose position and device are numbered k as well
+static void set_layout(uint32_t k)
+{
+    const std::wstring n = std::to_wstring(k);
+    _containers.clear();
+    std::shared_ptr<container_t> a = new_container(L"a" + n);
+    std::shared_ptr<container_t> b = new_container(L"b" + n);
+    const hmonitor_t hmon = reinterpret_cast<hmonitor_t>(static_cast<uintptr_t>(0x100));
+    monitor_info_t& info = _topology[hmon];
+    info.rect = {static_cast<int32_t>(k), 0, static_cast<int32_t>(k) + 1920, 1080};
+    info.device = L"DISPLAY" + n;
+    _monitors[hmon] = k % 2 ? b : a;
+}
+
+// everything in `p` belongs to the same layout, and it's not older than
+// the one read before
+static bool consistent(const status_payload_t& p, uint32_t& last)
+{
+    if (p.containers != 2 || p.monitors != 1) {
+        return false;
+    }
+    const status_monitor_t& m = p.monitor[0];
+    const uint32_t k = static_cast<uint32_t>(m.left);
+    const std::u16string n = u16(std::to_wstring(k));
+    const bool ok = k >= last
+        && m.right == m.left + 1920
+        && m.bottom == 1080
+        && m.container == static_cast<int32_t>(k % 2)
+        && status_name(m.device, 32) == u"DISPLAY" + n
+        && status_name(p.container[0], STATUS_NAME) == u"a" + n
+        && status_name(p.container[1], STATUS_NAME) == u"b" + n;
+    last = k;
+    return ok;
+}
+
+// one writer publishing as fast as it can, readers polling all the while:
+// no reader ever sees a mix of two layouts
+TEST(status, concurrent_readers)
+{
+    const uint32_t LAYOUTS = 20000;
+    const size_t READERS = 4;
+    std::unique_ptr<status_segment_t> segment(new status_segment_t());
+    core_reset();
+    set_layout(0);
+    status_attach(segment.get());
+
+    std::atomic<bool> done{false};
+    std::vector<size_t> reads(READERS);
+    std::vector<size_t> torn(READERS);
+    std::vector<std::thread> readers;
+    for(size_t r = 0; r < READERS; ++r) {
+        readers.emplace_back([&, r] {
+            status_payload_t p;
+            uint32_t last = 0;
+            while (!done.load()) {
+                if (!read_status(*segment, p)) {
+                    continue;
+                }
+                ++reads[r];
+                torn[r] += !consistent(p, last);
+            }
+        });
+    }
+    for(uint32_t k = 1; k <= LAYOUTS; ++k) {
+        set_layout(k);
+        publish_status();
+    }
+    done = true;
+    for(auto& t: readers) {
+        t.join();
+    }
+
+    for(size_t r = 0; r < READERS; ++r) {
+        CHECK(reads[r] > 0);
+        CHECK(torn[r] == 0);
+    }
+    status_payload_t p;
+    uint32_t last = 0;
+    CHECK(read_status(*segment, p));
+    CHECK(consistent(p, last));
+    CHECK(last == LAYOUTS);
+    status_attach(nullptr);
+    core_reset();
+}
@@ -0,0 +1,74 @@
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "fake_winsys.h"
+#include "test.h"
+#include "throttle.h"
+
+// the mail client's windows in a hidden container, an editor shown
+struct throttle_desktop_t {
+    fake_winsys_t ws;
+    hmonitor_t hmon;
+
+    throttle_desktop_t()
+    {
+        hmon = ws.add_monitor(1920, 1080);
+        for(int i = 0; i < 3; ++i) {
+            ws.add_window(hmon, L"Inbox " + std::to_wstring(i), L"MailWindow", 7);
+        }
+        ws.add_window(hmon, L"Editor", L"EditWindow", 8);
+        core_init(&ws, nullptr);
+        core_reset();
+        _throttle_policy = throttle_policy_t();
+        _throttle_policy.enabled = true;
+        scan_current_desktops();
+    }
+
+    ~throttle_desktop_t()
+    {
+        _throttle_policy = throttle_policy_t();
+        core_reset();
+    }
+};
+
+// a window the process opens on screen later brings it back right away,
+// without waiting for its container to be shown
+TEST(throttle, new_window_restores)
+{
+    throttle_desktop_t d;
+    CHECK(move_windows(MATCH_CLASS, L"mailwindow", L"mail") == 3);
+    CHECK(d.ws.throttled(7));
+    CHECK(!d.ws.throttled(8));
+    CHECK(throttled_processes() == 1);
+
+    d.ws.add_window(d.hmon, L"New message", L"MailWindow", 7);
+    scan_current_desktops();
+    CHECK(!d.ws.throttled(7));
+    CHECK(throttled_processes() == 0);
+    CHECK(_throttle_stats.restored == 1);
+}
+
+// process names are looked up once per process, not on every hide
+TEST(throttle, names_cached)
+{
+    throttle_desktop_t d;
+    CHECK(move_windows(MATCH_CLASS, L"mailwindow", L"mail") == 3);
+    d.ws.reset_calls();
+    for(int i = 0; i < 10; ++i) {
+        CHECK(switch_to_desktop(L"mail", false));
+        CHECK(!d.ws.throttled(7));
+        CHECK(d.ws.throttled(8));
+        CHECK(switch_to_desktop(L"main", false));
+        CHECK(d.ws.throttled(7));
+        CHECK(!d.ws.throttled(8));
+    }
+    // the editor's, the mail client's was known already
+    CHECK(d.ws.calls(TRACE_PROCESS_NAME) == 1);
+
+    // denied later on, the cached name still has to match
+    _throttle_policy.deny.insert(L"app7.exe");
+    CHECK(switch_to_desktop(L"mail", false));
+    CHECK(switch_to_desktop(L"main", false));
+    CHECK(!d.ws.throttled(7));
+}
@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "topology.h"
+
+static hmonitor_t handle(uintptr_t n)
+{
+    return reinterpret_cast<hmonitor_t>(n);
+}
+
+// a 1920x1080 screen `left` pixels right of the primary one
+static monitor_info_t screen(const wchar_t* device, const wchar_t* path, int32_t left, int32_t width = 1920)
+{
+    monitor_info_t info;
+    info.rect = {left, 0, left + width, 1080};
+    info.work = info.rect;
+    info.device = device;
+    info.path = path;
+    info.dpi = 96;
+    return info;
+}
+
+// where `from` ended up, checked to be matched exactly once
+static const monitor_remap_t* remap(const std::vector<monitor_remap_t>& remaps, hmonitor_t from)
+{
+    const monitor_remap_t* found = nullptr;
+    for(const auto& r: remaps) {
+        if (r.from == from) {
+            CHECK(!found);
+            found = &r;
+        }
+    }
+    return found;
+}
+
+// the same screens at the same places, all with new handles
+TEST(topology, new_handles)
+{
+    const topology_t before = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"path-a", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"path-b", 1920)},
+    };
+    const topology_t after = {
+        {handle(9), screen(L"\\\\.\\DISPLAY2", L"path-b", 1920)},
+        {handle(8), screen(L"\\\\.\\DISPLAY1", L"path-a", 0)},
+    };
+    const auto remaps = match_monitors(before, after);
+    CHECK(remaps.size() == 2);
+    CHECK(remap(remaps, handle(1))->to == handle(8));
+    CHECK(!remap(remaps, handle(1))->moved);
+    CHECK(remap(remaps, handle(2))->to == handle(9));
+    CHECK(!remap(remaps, handle(2))->moved);
+}
+
+// the screens swapped places: their paths win over the positions
+TEST(topology, swapped_paths)
+{
+    const topology_t before = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"path-a", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"path-b", 1920)},
+    };
+    const topology_t after = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"path-b", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"path-a", 1920)},
+    };
+    const auto remaps = match_monitors(before, after);
+    CHECK(remap(remaps, handle(1))->to == handle(2));
+    CHECK(remap(remaps, handle(1))->moved);
+    CHECK(remap(remaps, handle(2))->to == handle(1));
+    CHECK(remap(remaps, handle(2))->moved);
+}
+
+// without paths, the names got renumbered but the screens stayed put
+TEST(topology, renumbered_names)
+{
+    const topology_t before = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"", 1920)},
+    };
+    const topology_t after = {
+        {handle(3), screen(L"\\\\.\\DISPLAY2", L"", 0)},
+        {handle(4), screen(L"\\\\.\\DISPLAY1", L"", 1920)},
+    };
+    const auto remaps = match_monitors(before, after);
+    CHECK(remap(remaps, handle(1))->to == handle(3));
+    CHECK(!remap(remaps, handle(1))->moved);
+    CHECK(remap(remaps, handle(2))->to == handle(4));
+    CHECK(!remap(remaps, handle(2))->moved);
+}
+
+// the second screen is gone, the first one stays where it was even though
+// its name got renumbered
+TEST(topology, unplugged)
+{
+    const topology_t before = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"path-a", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"path-b", 1920)},
+    };
+    const topology_t after = {
+        {handle(5), screen(L"\\\\.\\DISPLAY3", L"path-a", 0)},
+    };
+    const auto remaps = match_monitors(before, after);
+    CHECK(remaps.size() == 2);
+    CHECK(remap(remaps, handle(1))->to == handle(5));
+    CHECK(!remap(remaps, handle(1))->moved);
+    CHECK(remap(remaps, handle(2))->to == nullptr);
+}
+
+// two screens of the same model report the same path: each one is
+// matched once, by its position, and both follow a resolution change
+TEST(topology, identical_screens)
+{
+    const topology_t before = {
+        {handle(1), screen(L"\\\\.\\DISPLAY1", L"path-same", 0)},
+        {handle(2), screen(L"\\\\.\\DISPLAY2", L"path-same", 1920)},
+    };
+    const topology_t after = {
+        {handle(7), screen(L"\\\\.\\DISPLAY2", L"path-same", 1920)},
+        {handle(6), screen(L"\\\\.\\DISPLAY1", L"path-same", 0)},
+    };
+    auto remaps = match_monitors(before, after);
+    CHECK(remap(remaps, handle(1))->to == handle(6));
+    CHECK(remap(remaps, handle(2))->to == handle(7));
+
+    // new handles, in the opposite order
+    const topology_t rescaled = {
+        {handle(10), screen(L"\\\\.\\DISPLAY2", L"path-same", 2560, 2560)},
+        {handle(11), screen(L"\\\\.\\DISPLAY1", L"path-same", 0, 2560)},
+    };
+    remaps = match_monitors(after, rescaled);
+    // the first one kept its top left corner
+    CHECK(remap(remaps, handle(6))->to == handle(11));
+    CHECK(remap(remaps, handle(7))->to == handle(10));
+    CHECK(remap(remaps, handle(6))->moved);
+    CHECK(remap(remaps, handle(7))->moved);
+}